@@ -52,6 +52,20 @@
 
 #include <cmath>
 
+// Lanes used by GetNoiseBatch, 1 when there is no SIMD instruction set to use and every position goes through GetNoise
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FNL_SIMD_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FNL_SIMD_LANES 4
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define FNL_SIMD_LANES 4
+#else
+#define FNL_SIMD_LANES 1
+#endif
+
 class FastNoiseLite
 {
 public:
@@ -285,6 +299,8 @@ public:
     /// </remarks>
     void SetDomainWarpAmp(float domainWarpAmp) { mDomainWarpAmp = domainWarpAmp; }
 
+    // Only the Set* methods write members. The noise and warp methods below only read the settings even though they
+    // are not const, so a configured instance can be sampled from any number of threads at once.
 
     /// <summary>
     /// 2D noise at given position using current settings
@@ -338,6 +354,34 @@ public:
         }
     }
 
+    /// <summary>
+    /// 2D noise at count positions using current settings, out[i] is the same as GetNoise(x[i], y[i])
+    /// </summary>
+    /// <remarks>
+    /// OpenSimplex2 and Perlin noise, with or without fractal, are evaluated FNL_SIMD_LANES positions at a time.
+    /// Other noise types go through GetNoise one position at a time
+    /// </remarks>
+    template <typename FNfloat>
+    void GetNoiseBatch(const FNfloat* x, const FNfloat* y, float* out, int count)
+    {
+        Arguments_must_be_floating_point_values<FNfloat>();
+
+#if FNL_SIMD_LANES > 1
+        if (mNoiseType == NoiseType_OpenSimplex2 || mNoiseType == NoiseType_Perlin)
+        {
+            for (int i = 0; i < count; i += FNL_SIMD_LANES)
+            {
+                GenBatchLanes(x + i, y + i, out + i, count - i < FNL_SIMD_LANES ? count - i : FNL_SIMD_LANES);
+            }
+            return;
+        }
+#endif
+        for (int i = 0; i < count; i++)
+        {
+            out[i] = GetNoise(x[i], y[i]);
+        }
+    }
+
 
     /// <summary>
     /// 2D warps the input position using current domain warp settings
@@ -1967,6 +2011,304 @@ private:
     }
 
 
+    // Batched 2D Noise
+
+#if FNL_SIMD_LANES > 1
+    // The few vector operations the batched noise needs, on whichever instruction set the compiler targets
+    struct Lanes
+    {
+#if defined(__AVX2__)
+        typedef __m256 F;
+        typedef __m256i I;
+        typedef __m256 M;
+
+        static F Load(const float* p) { return _mm256_loadu_ps(p); }
+        static I Load(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+        static void Store(float* p, F a) { _mm256_storeu_ps(p, a); }
+        static F Set(float f) { return _mm256_set1_ps(f); }
+        static I Set(int i) { return _mm256_set1_epi32(i); }
+
+        static F Add(F a, F b) { return _mm256_add_ps(a, b); }
+        static F Sub(F a, F b) { return _mm256_sub_ps(a, b); }
+        static F Mul(F a, F b) { return _mm256_mul_ps(a, b); }
+        static F Min(F a, F b) { return _mm256_min_ps(a, b); }
+        static F Abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static M Greater(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static F Select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+        static I Select(M m, I a, I b) { return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), m)); }
+        static F Mask(M m, F a) { return _mm256_and_ps(m, a); }
+
+        static I Add(I a, I b) { return _mm256_add_epi32(a, b); }
+        static I Mul(I a, I b) { return _mm256_mullo_epi32(a, b); }
+        static I Xor(I a, I b) { return _mm256_xor_si256(a, b); }
+        static I And(I a, I b) { return _mm256_and_si256(a, b); }
+        static I Or(I a, I b) { return _mm256_or_si256(a, b); }
+        static I ShiftRight(I a, int n) { return _mm256_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+        static I Truncate(F a) { return _mm256_cvttps_epi32(a); }
+        static F ToFloat(I a) { return _mm256_cvtepi32_ps(a); }
+        static F Gather(const float* table, I index) { return _mm256_i32gather_ps(table, index, 4); }
+#elif FNL_SIMD_LANES == 4 && !(defined(__ARM_NEON) || defined(_M_ARM64))
+        typedef __m128 F;
+        typedef __m128i I;
+        typedef __m128 M;
+
+        static F Load(const float* p) { return _mm_loadu_ps(p); }
+        static I Load(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+        static void Store(float* p, F a) { _mm_storeu_ps(p, a); }
+        static F Set(float f) { return _mm_set1_ps(f); }
+        static I Set(int i) { return _mm_set1_epi32(i); }
+
+        static F Add(F a, F b) { return _mm_add_ps(a, b); }
+        static F Sub(F a, F b) { return _mm_sub_ps(a, b); }
+        static F Mul(F a, F b) { return _mm_mul_ps(a, b); }
+        static F Min(F a, F b) { return _mm_min_ps(a, b); }
+        static F Abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static M Greater(F a, F b) { return _mm_cmpgt_ps(a, b); }
+        static F Select(M m, F a, F b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+        static I Select(M m, I a, I b) { return _mm_castps_si128(Select(m, _mm_castsi128_ps(a), _mm_castsi128_ps(b))); }
+        static F Mask(M m, F a) { return _mm_and_ps(m, a); }
+
+        static I Add(I a, I b) { return _mm_add_epi32(a, b); }
+        static I Mul(I a, I b)
+        {
+            // SSE2 only multiplies the even lanes, the odd ones are shifted down and multiplied separately
+            __m128i even = _mm_mul_epu32(a, b);
+            __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+        static I Xor(I a, I b) { return _mm_xor_si128(a, b); }
+        static I And(I a, I b) { return _mm_and_si128(a, b); }
+        static I Or(I a, I b) { return _mm_or_si128(a, b); }
+        static I ShiftRight(I a, int n) { return _mm_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+        static I Truncate(F a) { return _mm_cvttps_epi32(a); }
+        static F ToFloat(I a) { return _mm_cvtepi32_ps(a); }
+        static F Gather(const float* table, I index)
+        {
+            int i[4];
+            _mm_storeu_si128((__m128i*)i, index);
+            return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+        }
+#else
+        typedef float32x4_t F;
+        typedef int32x4_t I;
+        typedef uint32x4_t M;
+
+        static F Load(const float* p) { return vld1q_f32(p); }
+        static I Load(const int* p) { return vld1q_s32(p); }
+        static void Store(float* p, F a) { vst1q_f32(p, a); }
+        static F Set(float f) { return vdupq_n_f32(f); }
+        static I Set(int i) { return vdupq_n_s32(i); }
+
+        static F Add(F a, F b) { return vaddq_f32(a, b); }
+        static F Sub(F a, F b) { return vsubq_f32(a, b); }
+        static F Mul(F a, F b) { return vmulq_f32(a, b); }
+        static F Min(F a, F b) { return vminq_f32(a, b); }
+        static F Abs(F a) { return vabsq_f32(a); }
+        static M Greater(F a, F b) { return vcgtq_f32(a, b); }
+        static F Select(M m, F a, F b) { return vbslq_f32(m, a, b); }
+        static I Select(M m, I a, I b) { return vbslq_s32(m, a, b); }
+        static F Mask(M m, F a) { return vreinterpretq_f32_u32(vandq_u32(m, vreinterpretq_u32_f32(a))); }
+
+        static I Add(I a, I b) { return vaddq_s32(a, b); }
+        static I Mul(I a, I b) { return vmulq_s32(a, b); }
+        static I Xor(I a, I b) { return veorq_s32(a, b); }
+        static I And(I a, I b) { return vandq_s32(a, b); }
+        static I Or(I a, I b) { return vorrq_s32(a, b); }
+        static I ShiftRight(I a, int n) { return vshlq_s32(a, vdupq_n_s32(-n)); }
+        static I Truncate(F a) { return vcvtq_s32_f32(a); }
+        static F ToFloat(I a) { return vcvtq_f32_s32(a); }
+        static F Gather(const float* table, I index)
+        {
+            int i[4];
+            vst1q_s32(i, index);
+            float f[4] = { table[i[0]], table[i[1]], table[i[2]], table[i[3]] };
+            return vld1q_f32(f);
+        }
+#endif
+    };
+
+    // Same steps and order of operations as the scalar functions they stand for, so both paths give the same noise
+
+    static Lanes::F Lerp(Lanes::F a, Lanes::F b, Lanes::F t)
+    {
+        return Lanes::Add(a, Lanes::Mul(t, Lanes::Sub(b, a)));
+    }
+
+    static Lanes::F InterpQuintic(Lanes::F t)
+    {
+        Lanes::F poly = Lanes::Add(Lanes::Mul(t, Lanes::Sub(Lanes::Mul(t, Lanes::Set(6.0f)), Lanes::Set(15.0f))), Lanes::Set(10.0f));
+        return Lanes::Mul(Lanes::Mul(Lanes::Mul(t, t), t), poly);
+    }
+
+    static Lanes::F PingPong(Lanes::F t)
+    {
+        Lanes::I half = Lanes::Truncate(Lanes::Mul(t, Lanes::Set(0.5f)));
+        t = Lanes::Sub(t, Lanes::ToFloat(Lanes::Add(half, half)));
+        return Lanes::Select(Lanes::Greater(Lanes::Set(1.0f), t), t, Lanes::Sub(Lanes::Set(2.0f), t));
+    }
+
+    static Lanes::F GradCoord(Lanes::I seed, Lanes::I xPrimed, Lanes::I yPrimed, Lanes::F xd, Lanes::F yd)
+    {
+        Lanes::I hash = Lanes::Mul(Lanes::Xor(Lanes::Xor(seed, xPrimed), yPrimed), Lanes::Set(0x27d4eb2d));
+        hash = Lanes::Xor(hash, Lanes::ShiftRight(hash, 15));
+        hash = Lanes::And(hash, Lanes::Set(127 << 1));
+
+        Lanes::F xg = Lanes::Gather(Lookup<float>::Gradients2D, hash);
+        Lanes::F yg = Lanes::Gather(Lookup<float>::Gradients2D, Lanes::Or(hash, Lanes::Set(1)));
+
+        return Lanes::Add(Lanes::Mul(xd, xg), Lanes::Mul(yd, yg));
+    }
+
+    template <typename FNfloat>
+    void GenBatchLanes(const FNfloat* x, const FNfloat* y, float* out, int count)
+    {
+        // Lanes past count are padded with the first position and dropped on the way out
+        FNfloat xs[FNL_SIMD_LANES];
+        FNfloat ys[FNL_SIMD_LANES];
+        for (int i = 0; i < FNL_SIMD_LANES; i++)
+        {
+            xs[i] = x[i < count ? i : 0];
+            ys[i] = y[i < count ? i : 0];
+            TransformNoiseCoordinate(xs[i], ys[i]);
+        }
+
+        Lanes::F result;
+        if (mFractalType != FractalType_FBm && mFractalType != FractalType_Ridged && mFractalType != FractalType_PingPong)
+        {
+            result = GenBatchSingle(mSeed, xs, ys);
+        }
+        else
+        {
+            int seed = mSeed;
+            Lanes::F sum = Lanes::Set(0.0f);
+            Lanes::F amp = Lanes::Set(mFractalBounding);
+            Lanes::F one = Lanes::Set(1.0f);
+            Lanes::F weightedStrength = Lanes::Set(mWeightedStrength);
+
+            for (int octave = 0; octave < mOctaves; octave++)
+            {
+                Lanes::F noise = GenBatchSingle(seed++, xs, ys);
+                switch (mFractalType)
+                {
+                default:
+                    sum = Lanes::Add(sum, Lanes::Mul(noise, amp));
+                    amp = Lanes::Mul(amp, Lerp(one, Lanes::Mul(Lanes::Min(Lanes::Add(noise, one), Lanes::Set(2.0f)), Lanes::Set(0.5f)), weightedStrength));
+                    break;
+                case FractalType_Ridged:
+                    noise = Lanes::Abs(noise);
+                    sum = Lanes::Add(sum, Lanes::Mul(Lanes::Add(Lanes::Mul(noise, Lanes::Set(-2.0f)), one), amp));
+                    amp = Lanes::Mul(amp, Lerp(one, Lanes::Sub(one, noise), weightedStrength));
+                    break;
+                case FractalType_PingPong:
+                    noise = PingPong(Lanes::Mul(Lanes::Add(noise, one), Lanes::Set(mPingPongStength)));
+                    sum = Lanes::Add(sum, Lanes::Mul(Lanes::Mul(Lanes::Sub(noise, Lanes::Set(0.5f)), Lanes::Set(2.0f)), amp));
+                    amp = Lanes::Mul(amp, Lerp(one, noise, weightedStrength));
+                    break;
+                }
+
+                for (int i = 0; i < FNL_SIMD_LANES; i++)
+                {
+                    xs[i] *= mLacunarity;
+                    ys[i] *= mLacunarity;
+                }
+                amp = Lanes::Mul(amp, Lanes::Set(mGain));
+            }
+            result = sum;
+        }
+
+        float noise[FNL_SIMD_LANES];
+        Lanes::Store(noise, result);
+        for (int i = 0; i < count; i++)
+        {
+            out[i] = noise[i];
+        }
+    }
+
+    template <typename FNfloat>
+    Lanes::F GenBatchSingle(int seed, const FNfloat* x, const FNfloat* y)
+    {
+        // Cells are found per lane in the precision of the coordinates, everything after that runs in float lanes
+        int xCell[FNL_SIMD_LANES];
+        int yCell[FNL_SIMD_LANES];
+        float xFraction[FNL_SIMD_LANES];
+        float yFraction[FNL_SIMD_LANES];
+        for (int i = 0; i < FNL_SIMD_LANES; i++)
+        {
+            int xi = FastFloor(x[i]);
+            int yi = FastFloor(y[i]);
+            xFraction[i] = (float)(x[i] - xi);
+            yFraction[i] = (float)(y[i] - yi);
+            xCell[i] = xi * PrimeX;
+            yCell[i] = yi * PrimeY;
+        }
+
+        Lanes::I seeds = Lanes::Set(seed);
+        Lanes::I xPrimed = Lanes::Load(xCell);
+        Lanes::I yPrimed = Lanes::Load(yCell);
+        Lanes::F xd = Lanes::Load(xFraction);
+        Lanes::F yd = Lanes::Load(yFraction);
+
+        if (mNoiseType == NoiseType_Perlin)
+        {
+            return BatchPerlin(seeds, xPrimed, yPrimed, xd, yd);
+        }
+        return BatchSimplex(seeds, xPrimed, yPrimed, xd, yd);
+    }
+
+    static Lanes::F BatchSimplex(Lanes::I seed, Lanes::I i, Lanes::I j, Lanes::F xi, Lanes::F yi)
+    {
+        const float SQRT3 = 1.7320508075688772935274463415059f;
+        const float G2 = (3 - SQRT3) / 6;
+
+        Lanes::F zero = Lanes::Set(0.0f);
+        Lanes::F t = Lanes::Mul(Lanes::Add(xi, yi), Lanes::Set(G2));
+        Lanes::F x0 = Lanes::Sub(xi, t);
+        Lanes::F y0 = Lanes::Sub(yi, t);
+
+        Lanes::F a = Lanes::Sub(Lanes::Sub(Lanes::Set(0.5f), Lanes::Mul(x0, x0)), Lanes::Mul(y0, y0));
+        Lanes::F aa = Lanes::Mul(a, a);
+        Lanes::F n0 = Lanes::Mask(Lanes::Greater(a, zero), Lanes::Mul(Lanes::Mul(aa, aa), GradCoord(seed, i, j, x0, y0)));
+
+        Lanes::F c = Lanes::Add(Lanes::Mul(Lanes::Set((float)(2 * (1 - 2 * G2) * (1 / G2 - 2))), t), Lanes::Add(Lanes::Set((float)(-2 * (1 - 2 * G2) * (1 - 2 * G2))), a));
+        Lanes::F x2 = Lanes::Add(x0, Lanes::Set(2 * (float)G2 - 1));
+        Lanes::F y2 = Lanes::Add(y0, Lanes::Set(2 * (float)G2 - 1));
+        Lanes::F cc = Lanes::Mul(c, c);
+        Lanes::F n2 = Lanes::Mask(Lanes::Greater(c, zero),
+            Lanes::Mul(Lanes::Mul(cc, cc), GradCoord(seed, Lanes::Add(i, Lanes::Set(PrimeX)), Lanes::Add(j, Lanes::Set(PrimeY)), x2, y2)));
+
+        // Both choices of the middle corner at once, y0 > x0 picks the one above the diagonal
+        Lanes::M upper = Lanes::Greater(y0, x0);
+        Lanes::F x1 = Lanes::Add(x0, Lanes::Select(upper, Lanes::Set((float)G2), Lanes::Set((float)G2 - 1)));
+        Lanes::F y1 = Lanes::Add(y0, Lanes::Select(upper, Lanes::Set((float)G2 - 1), Lanes::Set((float)G2)));
+        Lanes::I i1 = Lanes::Select(upper, i, Lanes::Add(i, Lanes::Set(PrimeX)));
+        Lanes::I j1 = Lanes::Select(upper, Lanes::Add(j, Lanes::Set(PrimeY)), j);
+        Lanes::F b = Lanes::Sub(Lanes::Sub(Lanes::Set(0.5f), Lanes::Mul(x1, x1)), Lanes::Mul(y1, y1));
+        Lanes::F bb = Lanes::Mul(b, b);
+        Lanes::F n1 = Lanes::Mask(Lanes::Greater(b, zero), Lanes::Mul(Lanes::Mul(bb, bb), GradCoord(seed, i1, j1, x1, y1)));
+
+        return Lanes::Mul(Lanes::Add(Lanes::Add(n0, n1), n2), Lanes::Set(99.83685446303647f));
+    }
+
+    static Lanes::F BatchPerlin(Lanes::I seed, Lanes::I x0, Lanes::I y0, Lanes::F xd0, Lanes::F yd0)
+    {
+        Lanes::F one = Lanes::Set(1.0f);
+        Lanes::F xd1 = Lanes::Sub(xd0, one);
+        Lanes::F yd1 = Lanes::Sub(yd0, one);
+
+        Lanes::F xs = InterpQuintic(xd0);
+        Lanes::F ys = InterpQuintic(yd0);
+
+        Lanes::I x1 = Lanes::Add(x0, Lanes::Set(PrimeX));
+        Lanes::I y1 = Lanes::Add(y0, Lanes::Set(PrimeY));
+
+        Lanes::F xf0 = Lerp(GradCoord(seed, x0, y0, xd0, yd0), GradCoord(seed, x1, y0, xd1, yd0), xs);
+        Lanes::F xf1 = Lerp(GradCoord(seed, x0, y1, xd0, yd1), GradCoord(seed, x1, y1, xd1, yd1), xs);
+
+        return Lanes::Mul(Lerp(xf0, xf1, ys), Lanes::Set(1.4247691104677813f));
+    }
+#endif
+
+
     // Domain Warp
 
     template <typename FNfloat>
@@ -0,0 +1,224 @@
+﻿#include "MarchingCubes/CompressedVoxelBuffer.h"
+#include "MarchingCubes/VoxelBufferPool.h"
+#include "Misc/Compression.h"
+
+void FCompressedVoxelBuffer::Compress(const FVoxelBuffer& Voxels)
+{
+	if (Voxels.Layout == EVoxelLayout::Linear)
+	{
+		CompressLinear(Voxels);
+		return;
+	}
+
+	FVoxelBuffer LinearVoxels;
+	LinearVoxels.Init(Voxels.Size);
+	LinearVoxels.CopyVoxels(Voxels);
+	CompressLinear(LinearVoxels);
+	Layout = Voxels.Layout;
+}
+
+bool FCompressedVoxelBuffer::Decompress(FVoxelBuffer& OutVoxels) const
+{
+	if (Layout == EVoxelLayout::Linear) return DecompressLinear(OutVoxels);
+
+	FVoxelBuffer LinearVoxels;
+	if (!DecompressLinear(LinearVoxels))
+	{
+		OutVoxels.Empty();
+		return false;
+	}
+	OutVoxels.Init(Size, Layout);
+	OutVoxels.CopyVoxels(LinearVoxels);
+	return true;
+}
+
+void FCompressedVoxelBuffer::CompressLinear(const FVoxelBuffer& Voxels)
+{
+	Empty();
+	Size = Voxels.Size;
+	NumVoxels = Voxels.Num();
+	check(NumVoxels == Size * Size * Size);
+	if (NumVoxels == 0) return;
+	PlaneSlots = MakeUnique<std::atomic<const FVoxelPlane*>[]>(3 * Size);
+
+	int16 PaletteIndex[256];
+	FMemory::Memset(PaletteIndex, -1, sizeof(PaletteIndex));
+	for (int First = 0; First < NumVoxels;)
+	{
+		const uint8 Material = Voxels.Materials[First];
+		int End = First + 1;
+		while (End < NumVoxels && End - First < MaxRunLength && Voxels.Materials[End] == Material) End++;
+
+		if (PaletteIndex[Material] < 0)
+		{
+			PaletteIndex[Material] = static_cast<int16>(Palette.Num());
+			Palette.Add(Material);
+		}
+		MaterialRuns.Add(static_cast<uint32>(End - First) << 8 | static_cast<uint8>(PaletteIndex[Material]));
+		First = End;
+	}
+	MaterialRuns.Shrink();
+
+	// Wrapping differences, so every miss fits in an int16 again
+	TArray<int16> Differences;
+	Differences.SetNumUninitialized(NumVoxels);
+	const int16* Source = Voxels.Densities.GetData();
+	for (int z = 0, i = 0; z < Size; z++)
+	{
+		for (int y = 0; y < Size; y++)
+		{
+			for (int x = 0; x < Size; x++, i++)
+			{
+				Differences[i] = static_cast<int16>(static_cast<uint16>(Source[i]) - PredictDensity(Source, x, y, z, Size));
+			}
+		}
+	}
+
+	const int32 RawSize = NumVoxels * sizeof(int16);
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_LZ4, RawSize);
+	Densities.SetNumUninitialized(CompressedSize);
+	bDensitiesCompressed = FCompression::CompressMemory(NAME_LZ4, Densities.GetData(), CompressedSize, Differences.GetData(), RawSize) && CompressedSize < RawSize;
+	if (bDensitiesCompressed)
+	{
+		Densities.SetNum(CompressedSize);
+	}
+	else
+	{
+		Densities.SetNumUninitialized(RawSize);
+		FMemory::Memcpy(Densities.GetData(), Differences.GetData(), RawSize);
+	}
+	Densities.Shrink();
+}
+
+bool FCompressedVoxelBuffer::DecompressLinear(FVoxelBuffer& OutVoxels) const
+{
+	OutVoxels.Init(Size);
+	if (NumVoxels == 0) return true;
+
+	const int32 RawSize = NumVoxels * sizeof(int16);
+	if (bDensitiesCompressed)
+	{
+		if (!FCompression::UncompressMemory(NAME_LZ4, OutVoxels.Densities.GetData(), RawSize, Densities.GetData(), Densities.Num()))
+		{
+			OutVoxels.Empty();
+			return false;
+		}
+	}
+	else
+	{
+		FMemory::Memcpy(OutVoxels.Densities.GetData(), Densities.GetData(), RawSize);
+	}
+
+	// In the same order as they were packed, so the voxels a guess is made from are already restored
+	int16* Target = OutVoxels.Densities.GetData();
+	for (int z = 0, i = 0; z < Size; z++)
+	{
+		for (int y = 0; y < Size; y++)
+		{
+			for (int x = 0; x < Size; x++, i++)
+			{
+				Target[i] = static_cast<int16>(static_cast<uint16>(Target[i]) + PredictDensity(Target, x, y, z, Size));
+			}
+		}
+	}
+
+	uint8* Materials = OutVoxels.Materials.GetData();
+	for (const uint32 Run : MaterialRuns)
+	{
+		const int Length = Run >> 8;
+		FMemory::Memset(Materials, Palette[Run & 0xFF], Length);
+		Materials += Length;
+	}
+	return true;
+}
+
+FVoxel FCompressedVoxelBuffer::GetVoxel(const int X, const int Y, const int Z, const int Axis) const
+{
+	const FIntVector Position(X, Y, Z);
+	const FVoxelPlane& Plane = GetPlane(Axis, Position[Axis]);
+	const int U = Axis == 0 ? Y : X;
+	const int V = Axis == 2 ? Y : Z;
+	const int Index = U + Size * V;
+	return FVoxel(Plane.Densities[Index] * FVoxelBuffer::DensityStep, Plane.Materials[Index]);
+}
+
+const FVoxelPlane& FCompressedVoxelBuffer::GetPlane(const int Axis, const int Coordinate) const
+{
+	std::atomic<const FVoxelPlane*>& Slot = PlaneSlots[Axis * Size + Coordinate];
+	if (const FVoxelPlane* Found = Slot.load(std::memory_order_acquire)) return *Found;
+
+	FScopeLock Lock(&PlaneLock);
+	if (const FVoxelPlane* Found = Slot.load(std::memory_order_relaxed)) return *Found;
+
+	FVoxelPlane& Plane = *Planes.Add_GetRef(MakeUnique<FVoxelPlane>());
+	Plane.Densities.SetNumUninitialized(Size * Size);
+	Plane.Materials.SetNumUninitialized(Size * Size);
+	FVoxelBuffer LinearVoxels;
+	FVoxelBufferPool::Get().Allocate(LinearVoxels, Size, EVoxelLayout::Linear);
+	if (DecompressLinear(LinearVoxels))
+	{
+		const int AxisU = Axis == 0 ? 1 : 0;
+		const int AxisV = Axis == 2 ? 1 : 2;
+		FIntVector Position;
+		Position[Axis] = Coordinate;
+		for (int v = 0, i = 0; v < Size; v++)
+		{
+			Position[AxisV] = v;
+			for (int u = 0; u < Size; u++, i++)
+			{
+				Position[AxisU] = u;
+				const int Index = FLinearVoxelLayout::GetIndex(Position.X, Position.Y, Position.Z, Size);
+				Plane.Densities[i] = LinearVoxels.Densities[Index];
+				Plane.Materials[i] = LinearVoxels.Materials[Index];
+			}
+		}
+	}
+	else
+	{
+		// Read as air, the chunk regenerates once it is unpacked itself
+		FMemory::Memset(Plane.Materials.GetData(), 0, Size * Size);
+		for (int16& Density : Plane.Densities) Density = FVoxelBuffer::QuantizeDensity(1.0f);
+	}
+	FVoxelBufferPool::Get().Release(LinearVoxels);
+	Slot.store(&Plane, std::memory_order_release);
+	return Plane;
+}
+
+uint16 FCompressedVoxelBuffer::PredictDensity(const int16* Values, const int X, const int Y, const int Z, const int Stride)
+{
+	// Extends the voxels on the lower corner of the cube ending at this one linearly along every axis, which is exact
+	// for the planes and height fields most chunks hold. Voxels past the lower faces count as zero.
+	auto Get = [Values, X, Y, Z, Stride](const int DX, const int DY, const int DZ) -> int32
+	{
+		if (X < DX || Y < DY || Z < DZ) return 0;
+		return Values[X - DX + Stride * (Y - DY + Stride * (Z - DZ))];
+	};
+	const int32 Prediction = Get(1, 0, 0) + Get(0, 1, 0) + Get(0, 0, 1)
+		- Get(1, 1, 0) - Get(1, 0, 1) - Get(0, 1, 1)
+		+ Get(1, 1, 1);
+	return static_cast<uint16>(Prediction);
+}
+
+void FCompressedVoxelBuffer::Empty()
+{
+	Size = 0;
+	NumVoxels = 0;
+	Layout = EVoxelLayout::Linear;
+	Palette.Empty();
+	MaterialRuns.Empty();
+	Densities.Empty();
+	bDensitiesCompressed = false;
+	PlaneSlots.Reset();
+	Planes.Empty();
+}
+
+int64 FCompressedVoxelBuffer::GetAllocatedSize() const
+{
+	int64 PlaneBytes = PlaneSlots ? 3 * Size * sizeof(std::atomic<const FVoxelPlane*>) : 0;
+	FScopeLock Lock(&PlaneLock);
+	for (const TUniquePtr<FVoxelPlane>& Plane : Planes)
+	{
+		PlaneBytes += sizeof(FVoxelPlane) + Plane->Densities.GetAllocatedSize() + Plane->Materials.GetAllocatedSize();
+	}
+	return Palette.GetAllocatedSize() + MaterialRuns.GetAllocatedSize() + Densities.GetAllocatedSize() + PlaneBytes;
+}
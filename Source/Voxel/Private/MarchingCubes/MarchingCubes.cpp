@@ -1,6 +1,6 @@
 #include "MarchingCubes/MarchingCubes.h"
 
-void FMarchingCubes::InsertTrianglesOfCube(FVector* P, float* Val, TArray<FVector>& Triangles) const
+int FMarchingCubes::GetCubeIndex(const float* Val)
 {
 	int CubeIndex = 0;
 	if (Val[0] < IsoLevel) CubeIndex |= 1;
@@ -11,49 +11,32 @@ void FMarchingCubes::InsertTrianglesOfCube(FVector* P, float* Val, TArray<FVecto
 	if (Val[5] < IsoLevel) CubeIndex |= 32;
 	if (Val[6] < IsoLevel) CubeIndex |= 64;
 	if (Val[7] < IsoLevel) CubeIndex |= 128;
+	return CubeIndex;
+}
 
-	if (EdgeTable[CubeIndex] == 0) return;
-
-	FVector Vertices[12];
-	if ((EdgeTable[CubeIndex] & 1) == 1)
-		Vertices[0] = InterpolateVertex(IsoLevel, P[0], P[1], Val[0], Val[1]);
-	if ((EdgeTable[CubeIndex] & 2) == 2)
-		Vertices[1] = InterpolateVertex(IsoLevel, P[1], P[2], Val[1], Val[2]);
-	if ((EdgeTable[CubeIndex] & 4) == 4)
-		Vertices[2] = InterpolateVertex(IsoLevel, P[2], P[3], Val[2], Val[3]);
-	if ((EdgeTable[CubeIndex] & 8) == 8)
-		Vertices[3] = InterpolateVertex(IsoLevel, P[3], P[0], Val[3], Val[0]);
-	if ((EdgeTable[CubeIndex] & 16) == 16)
-		Vertices[4] = InterpolateVertex(IsoLevel, P[4], P[5], Val[4], Val[5]);
-	if ((EdgeTable[CubeIndex] & 32) == 32)
-		Vertices[5] = InterpolateVertex(IsoLevel, P[5], P[6], Val[5], Val[6]);
-	if ((EdgeTable[CubeIndex] & 64) == 64)
-		Vertices[6] = InterpolateVertex(IsoLevel, P[6], P[7], Val[6], Val[7]);
-	if ((EdgeTable[CubeIndex] & 128) == 128)
-		Vertices[7] = InterpolateVertex(IsoLevel, P[7], P[4], Val[7], Val[4]);
-	if ((EdgeTable[CubeIndex] & 256) == 256)
-		Vertices[8] = InterpolateVertex(IsoLevel, P[0], P[4], Val[0], Val[4]);
-	if ((EdgeTable[CubeIndex] & 512) == 512)
-		Vertices[9] = InterpolateVertex(IsoLevel, P[1], P[5], Val[1], Val[5]);
-	if ((EdgeTable[CubeIndex] & 1024) == 1024)
-		Vertices[10] = InterpolateVertex(IsoLevel, P[2], P[6], Val[2], Val[6]);
-	if ((EdgeTable[CubeIndex] & 2048) == 2048)
-		Vertices[11] = InterpolateVertex(IsoLevel, P[3], P[7], Val[3], Val[7]);
+int FMarchingCubes::GetTriangleCount(const int CubeIndex)
+{
+	int Count = 0;
+	while (TriTable[CubeIndex][Count * 3] != -1) Count++;
+	return Count;
+}
 
+void FMarchingCubes::InsertTrianglesOfCube(const int CubeIndex, const int32* EdgeVertices, TArray<int>& Triangles)
+{
 	for (int i = 0; TriTable[CubeIndex][i] != -1; i += 3) {
-		Triangles.Add(Vertices[TriTable[CubeIndex][i]]);
-		Triangles.Add(Vertices[TriTable[CubeIndex][i + 1]]);
-		Triangles.Add(Vertices[TriTable[CubeIndex][i + 2]]);
+		Triangles.Add(EdgeVertices[TriTable[CubeIndex][i]]);
+		Triangles.Add(EdgeVertices[TriTable[CubeIndex][i + 1]]);
+		Triangles.Add(EdgeVertices[TriTable[CubeIndex][i + 2]]);
 	}
 }
 
-FVector FMarchingCubes::InterpolateVertex(const float Iso, const FVector P1, const FVector P2, const float ValP1, const float ValP2) const
+FVector FMarchingCubes::InterpolateVertex(const float Iso, const FVector P1, const FVector P2, const float ValP1, const float ValP2)
 {
 	if (FMath::Abs(Iso - ValP1) < 0.00001) return (P1);
 	if (FMath::Abs(Iso - ValP2) < 0.00001) return (P2);
 	if (FMath::Abs(ValP1 - ValP2) < 0.00001) return (P1);
 	
-	const float Mu = (Iso - ValP1) / (ValP2 - ValP1);
+	const float Mu = GetCrossing(Iso, ValP1, ValP2);
 	
 	FVector P;
 	P.X = P1.X + Mu * (P2.X - P1.X);
@@ -62,3 +45,12 @@ FVector FMarchingCubes::InterpolateVertex(const float Iso, const FVector P1, con
 
 	return P;
 }
+
+float FMarchingCubes::GetCrossing(const float Iso, const float ValP1, const float ValP2)
+{
+	if (FMath::Abs(Iso - ValP1) < 0.00001) return 0;
+	if (FMath::Abs(Iso - ValP2) < 0.00001) return 1;
+	if (FMath::Abs(ValP1 - ValP2) < 0.00001) return 0;
+
+	return (Iso - ValP1) / (ValP2 - ValP1);
+}
@@ -3,6 +3,9 @@
 #include "MarchingCubes/MeshBuilder.h"
 #include "MarchingCubes/MeshData.h"
 #include "MarchingCubes/VoxelMaterial.h"
+#include "Algo/BinarySearch.h"
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
 
 // FMCMesh FMCMeshBuilder::Build(FVoxel* Data, int Size)
 // {
@@ -17,14 +20,14 @@
 // 	for (int z = 0; z < Size; z += Steps) {
 // 		for (int y = 0; y < Size; y += Steps) {
 // 			for (int x = 0; x < Size; x += Steps) {
-// 				W[0] = Data[GetIndex(DataOffset+x,		DataOffset+y,		DataOffset+z,		Size + DataPadding)].Density;
-// 				W[1] = Data[GetIndex(DataOffset+x,		DataOffset+y,		DataOffset+z + Steps,	Size + DataPadding)].Density;
-// 				W[2] = Data[GetIndex(DataOffset+x + Steps,	DataOffset+y,		DataOffset+z + Steps,	Size + DataPadding)].Density;
-// 				W[3] = Data[GetIndex(DataOffset+x + Steps,	DataOffset+y,		DataOffset+z,		Size + DataPadding)].Density;
-// 				W[4] = Data[GetIndex(DataOffset+x,		DataOffset+y + Steps,DataOffset+	z,		Size + DataPadding)].Density;
-// 				W[5] = Data[GetIndex(DataOffset+x,		DataOffset+y + Steps,DataOffset+	z + Steps,	Size + DataPadding)].Density;
-// 				W[6] = Data[GetIndex(DataOffset+x + Steps,	DataOffset+y + Steps,	DataOffset+z + Steps,	Size + DataPadding)].Density;
-// 				W[7] = Data[GetIndex(DataOffset+x + Steps,	DataOffset+y + Steps,	DataOffset+z,		Size + DataPadding)].Density;
+// 				W[0] = Data.GetDensity(GetIndex(DataOffset+x,		DataOffset+y,		DataOffset+z,		Size + DataPadding));
+// 				W[1] = Data.GetDensity(GetIndex(DataOffset+x,		DataOffset+y,		DataOffset+z + Steps,	Size + DataPadding));
+// 				W[2] = Data.GetDensity(GetIndex(DataOffset+x + Steps,	DataOffset+y,		DataOffset+z + Steps,	Size + DataPadding));
+// 				W[3] = Data.GetDensity(GetIndex(DataOffset+x + Steps,	DataOffset+y,		DataOffset+z,		Size + DataPadding));
+// 				W[4] = Data.GetDensity(GetIndex(DataOffset+x,		DataOffset+y + Steps,DataOffset+	z,		Size + DataPadding));
+// 				W[5] = Data.GetDensity(GetIndex(DataOffset+x,		DataOffset+y + Steps,DataOffset+	z + Steps,	Size + DataPadding));
+// 				W[6] = Data.GetDensity(GetIndex(DataOffset+x + Steps,	DataOffset+y + Steps,	DataOffset+z + Steps,	Size + DataPadding));
+// 				W[7] = Data.GetDensity(GetIndex(DataOffset+x + Steps,	DataOffset+y + Steps,	DataOffset+z,		Size + DataPadding));
 //
 // 				SetVectors(Pos, x / Steps, y / Steps, z / Steps);
 // 				MarchingCubes.InsertTrianglesOfCube(Pos, W, NewTriangles);
@@ -61,80 +64,635 @@
 // 	return Mesh;
 // }
 
-FMCMesh FMCMeshBuilder::Build(FVoxel* Data, int Size)
+namespace
 {
-	FMCMesh Mesh;
-	TArray<FVector> NewTriangles;
+	// Corner offsets matching the layout of FMCMeshBuilder::SetVectors
+	constexpr int CornerOffsets[8][3] = {
+		{0, 0, 0}, {0, 0, 1}, {1, 0, 1}, {1, 0, 0},
+		{0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 1, 0}
+	};
 
-	// 重置内部状态
-	IndexToVertex.Empty();
-	IndexToNormal.Empty();
-	VertexToIndex.Empty();
-	Triangles.Empty();
+	// Every cube edge as (lower corner, upper corner, axis) so shared edges are always interpolated in the same direction
+	constexpr int CubeEdges[12][3] = {
+		{0, 1, 2}, {1, 2, 0}, {3, 2, 2}, {0, 3, 0},
+		{4, 5, 2}, {5, 6, 0}, {7, 6, 2}, {4, 7, 0},
+		{0, 4, 1}, {1, 5, 1}, {2, 6, 1}, {3, 7, 1}
+	};
 
-	const float VoxelSize = 100.0;
+	// Faces of a transition cell as the points around them, counter-clockwise seen from outside the cell.
+	// Points 0-8 sample the full resolution face at u + 3v, points 9-12 the half resolution face inside the chunk
+	// at 9 + u + 2v, with the values of the full resolution corners.
+	constexpr int TransitionCellFaces[9][5] = {
+		{0, 3, 4, 1, -1}, {1, 4, 5, 2, -1}, {3, 6, 7, 4, -1}, {4, 7, 8, 5, -1},
+		{9, 10, 12, 11, -1},
+		{9, 11, 6, 3, 0}, {2, 5, 8, 12, 10}, {0, 1, 2, 10, 9}, {11, 12, 8, 7, 6}
+	};
+}
+
+FMCMesh FMCMeshBuilder::Build(const FVoxelBuffer& Voxels, const int Size, const FVoxelSummary* Summary, const int Lod, const ETransitionFace TransitionFaces)
+{
+	FVoxelMeshInput Input;
+	Input.Voxels = &Voxels;
+	Input.Size = Size;
+	Input.Summary = Summary;
+	Input.Lod = Lod;
+	Input.TransitionFaces = TransitionFaces;
+	return Build(Input);
+}
+
+void FMCMeshBuilder::Build(const FVoxelMeshInput& Input, FVoxelMeshOutput& Output)
+{
+	const TVoxelMesherWorkspace<FWorkspace> Borrowed;
+	FWorkspace& Workspace = *Borrowed;
+	if (Input.bIncremental && BuildDirtySlabs(Workspace, Input, Output)) return;
+
+	const FVoxelBuffer& Data = *Input.Voxels;
+	const int Size = Input.Size;
+	const FVoxelSummary* Summary = Input.Summary;
+	const int Cells = Size - 1;
+	Output.Reset();
+	bSlabsCached = false;
+	if (Cells <= 0) return;
+	if (Summary && !Summary->HasSurface(FMarchingCubes::IsoLevel)) return;
+
+	// Coarser levels keep at least two cells per axis and only sample voxels that exist
+	Step = 1;
+	for (int Lod = Input.Lod; Lod > 0 && Cells % (Step * 2) == 0 && Cells / (Step * 2) >= 2; Lod--) Step *= 2;
+	Transitions = Step > 1 ? Input.TransitionFaces : ETransitionFace::None;
+	Workspace.BoundaryEdges.Reset();
+
+	const FVoxelBuffer* Grid = &Data;
+	int GridSize = Size;
+	if (Step > 1)
+	{
+		GridSize = Cells / Step + 1;
+		SampleLod(Workspace, Data, Size, GridSize);
+		Grid = &Workspace.LodData;
+		Summary = nullptr;
+	}
+	const int GridCells = GridSize - 1;
+
+	const int NumSlabs = FMath::Max(1, GridCells / SlabLayers);
+	PrepareSlabs(Workspace, NumSlabs, GridCells);
+	Parts.SetNum(NumSlabs);
+
+	TArray<FSlab>& Slabs = Workspace.Slabs;
+	ParallelFor(NumSlabs, [this, &Slabs, &Input, Grid, GridSize, GridCells, Summary](const int32 i)
+	{
+		BuildSlab(*Grid, GridSize, Summary, Slabs[i]);
+		ComputeNormals(Input, Slabs[i].Crossings, Slabs[i].Mesh.Normals);
+
+		// Regular cells give up a band along each transition face, which the transition cells fill in
+		if (Transitions != ETransitionFace::None)
+		{
+			for (FVector& Vertex : Slabs[i].Mesh.Vertices)
+			{
+				Vertex = DisplaceVertex(Vertex, GridCells);
+			}
+		}
+	});
+
+	int VertexCount = 0;
+	int IndexCount = 0;
+	for (int i = 0; i < NumSlabs; i++)
+	{
+		VertexCount += Slabs[i].Mesh.Vertices.Num();
+		IndexCount += Slabs[i].Mesh.Triangles.Num();
+	}
+	Output.Reserve(VertexCount, IndexCount);
+
+	// Slabs are appended in order, so vertices and triangles come out exactly as a single pass would emit them
+	for (int i = 0; i < NumSlabs; i++)
+	{
+		StitchSlab(Workspace, i, Output);
+	}
+	bSlabsCached = Step == 1;
+	CachedSize = Size;
+
+	if (Transitions != ETransitionFace::None)
+	{
+		FMCMesh& TransitionMesh = Workspace.TransitionMesh;
+		TransitionMesh.Reset();
+		Workspace.TransitionCrossings.Reset();
+		for (int Face = 0; Face < 6; Face++)
+		{
+			if (!EnumHasAnyFlags(Transitions, static_cast<ETransitionFace>(1 << Face))) continue;
+			Data.VisitLayout([&](const auto Layout) { BuildTransitionCells(Workspace, Data, Layout, Size, Face); });
+		}
+		ComputeNormals(Input, Workspace.TransitionCrossings, TransitionMesh.Normals);
+		Output.AppendVertices(TransitionMesh, Workspace.TransitionIds);
+		for (int& Index : TransitionMesh.Triangles)
+		{
+			if (Index < INDEX_NONE) Index = Workspace.TransitionIds[-2 - Index];
+		}
+		Output.AppendTriangles(TransitionMesh.Triangles, Workspace.TransitionTriangles);
+	}
+}
+
+void FMCMeshBuilder::PrepareSlabs(FWorkspace& Workspace, const int NumSlabs, const int GridCells)
+{
+	if (Workspace.Slabs.Num() < NumSlabs) Workspace.Slabs.SetNum(NumSlabs);
+	for (int i = 0; i < NumSlabs; i++)
+	{
+		Workspace.Slabs[i].ZBegin = i * SlabLayers;
+		Workspace.Slabs[i].ZEnd = i == NumSlabs - 1 ? GridCells : (i + 1) * SlabLayers;
+	}
+}
+
+bool FMCMeshBuilder::BuildDirtySlabs(FWorkspace& Workspace, const FVoxelMeshInput& Input, FVoxelMeshOutput& Output)
+{
+	const int Size = Input.Size;
+	const int Cells = Size - 1;
+	if (!bSlabsCached || CachedSize != Size || Input.Lod > 0 || !Output.SupportsRemoval()) return false;
+	if (Input.Summary && !Input.Summary->HasSurface(FMarchingCubes::IsoLevel)) return false;
+
+	// A voxel moves the vertices of the cells around it and the normals read one voxel further out
+	const int CellBegin = FMath::Clamp(Input.DirtyMin.Z - 2, 0, Cells - 1);
+	const int CellEnd = FMath::Clamp(Input.DirtyMax.Z + 1, 0, Cells - 1);
+	const int NumSlabs = Parts.Num();
+	const int First = FMath::Min(CellBegin / SlabLayers, NumSlabs - 1);
+	const int Last = FMath::Min(CellEnd / SlabLayers, NumSlabs - 1);
+	const int Restitched = FMath::Min(Last + 1, NumSlabs - 1);
+
+	// The slab above shares the top plane of the last one, its triangles have to be written out again but its vertices stay.
+	// Dropping it first lets the old top plane vertices go away with the last triangles of the rebuilt slabs.
+	if (Restitched > Last) Output.RemoveTriangles(Parts[Restitched].OutputTriangles, true);
+	for (int i = First; i <= Last; i++)
+	{
+		Output.RemoveTriangles(Parts[i].OutputTriangles, false);
+	}
+
+	// The workspace may have meshed other chunks since, only the slabs built here are read back.
+	// Edits are remeshed a whole slab of layers at a time rather than per block of cells, slabs only share their Z planes
+	// so a rebuilt slab can be spliced back without touching the vertices of its X/Y neighbours.
+	PrepareSlabs(Workspace, NumSlabs, Cells);
+	Workspace.BoundaryEdges.Reset();
+	TArray<FSlab>& Slabs = Workspace.Slabs;
+	const FVoxelSummary* Summary = Input.Summary;
+	ParallelFor(Last - First + 1, [this, &Slabs, &Input, Size, Summary, First](const int32 i)
+	{
+		BuildSlab(*Input.Voxels, Size, Summary, Slabs[First + i]);
+		ComputeNormals(Input, Slabs[First + i].Crossings, Slabs[First + i].Mesh.Normals);
+	});
+
+	for (int i = First; i <= Restitched; i++)
+	{
+		StitchSlab(Workspace, i, Output, i <= Last);
+	}
+	return true;
+}
+
+void FMCMeshBuilder::SampleLod(FWorkspace& Workspace, const FVoxelBuffer& Data, const int Size, const int LodSize) const
+{
+	FVoxelBuffer& LodData = Workspace.LodData;
+	LodData.Init(LodSize);
+	Data.VisitLayout([&](const auto Layout)
+	{
+		for (int z = 0; z < LodSize; z++)
+		{
+			for (int y = 0; y < LodSize; y++)
+			{
+				for (int x = 0; x < LodSize; x++)
+				{
+					const int Index = GetIndex(x, y, z, LodSize);
+					const int Source = Layout.GetIndex(x * Step, y * Step, z * Step, Size);
+					LodData.Densities[Index] = Data.Densities[Source];
+					LodData.Materials[Index] = Data.Materials[Source];
+				}
+			}
+		}
+	});
+}
+
+template <typename LayoutType>
+void FMCMeshBuilder::BuildTransitionCells(FWorkspace& Workspace, const FVoxelBuffer& Data, const LayoutType Layout, const int Size, const int Face) const
+{
+	// Transition cells lie between a face of the chunk, sampled at the finer level of the neighbour, and the regular cells
+	// pulled back from it. The surface in a cell is found by walking the crossings around its faces, inside corners are
+	// always kept apart like the regular cells do, and every loop is closed with a fan.
+	const int Axis = Face / 2;
+	const bool bHighSide = Face % 2 == 1;
+	const int AxisU = (Axis + 1) % 3;
+	const int AxisV = (Axis + 2) % 3;
+	const int Half = Step / 2;
+	const int FaceCells = (Size - 1) / Step;
+
+	FIntVector Points[13];
+	float Val[13];
+	int32 From[16];
+	int32 To[16];
+	bool bUsed[16];
+
+	for (int cv = 0; cv < FaceCells; cv++)
+	{
+		for (int cu = 0; cu < FaceCells; cu++)
+		{
+			int Inside = 0;
+			for (int i = 0; i < 9; i++)
+			{
+				FIntVector& P = Points[i];
+				P[Axis] = bHighSide ? Size - 1 : 0;
+				P[AxisU] = cu * Step + i % 3 * Half;
+				P[AxisV] = cv * Step + i / 3 * Half;
+				Val[i] = Data.GetDensity(Layout.GetIndex(P.X, P.Y, P.Z, Size));
+				if (Val[i] < FMarchingCubes::IsoLevel) Inside++;
+			}
+			if (Inside == 0 || Inside == 9) continue;
+
+			for (int i = 0; i < 4; i++)
+			{
+				const int Corner = i % 2 * 2 + i / 2 * 6;
+				Points[9 + i] = Points[Corner];
+				Val[9 + i] = Val[Corner];
+			}
+
+			int Segments = 0;
+			for (const int* Polygon : TransitionCellFaces)
+			{
+				const int Count = Polygon[4] == -1 ? 4 : 5;
+				int32 Entry = INDEX_NONE;
+				int32 FirstExit = INDEX_NONE;
+				for (int i = 0; i < Count; i++)
+				{
+					const int A = Polygon[i];
+					const int B = Polygon[(i + 1) % Count];
+					const bool bInsideA = Val[A] < FMarchingCubes::IsoLevel;
+					const bool bInsideB = Val[B] < FMarchingCubes::IsoLevel;
+					if (bInsideA == bInsideB || (A < 9) != (B < 9)) continue;
+
+					const bool bForward = Points[A][AxisU] + Points[A][AxisV] < Points[B][AxisU] + Points[B][AxisV];
+					const int32 Id = bForward ?
+						GetTransitionVertex(Workspace, Data, Layout, Size, Points[A], Points[B], Val[A], Val[B], A >= 9) :
+						GetTransitionVertex(Workspace, Data, Layout, Size, Points[B], Points[A], Val[B], Val[A], A >= 9);
+
+					if (bInsideB)
+					{
+						Entry = Id;
+					}
+					else if (Entry != INDEX_NONE)
+					{
+						// Leaving the inside corners again, connect back to where they were entered so they stay apart
+						From[Segments] = Id;
+						To[Segments++] = Entry;
+					}
+					else
+					{
+						FirstExit = Id;
+					}
+				}
+				if (FirstExit != INDEX_NONE)
+				{
+					From[Segments] = FirstExit;
+					To[Segments++] = Entry;
+				}
+			}
+
+			// The segments form closed loops since every crossing leaves one face and enters the next
+			FMemory::Memzero(bUsed, sizeof(bUsed));
+			for (int Start = 0; Start < Segments; Start++)
+			{
+				if (bUsed[Start]) continue;
+
+				int32 Loop[16];
+				int Count = 0;
+				for (int i = Start; !bUsed[i];)
+				{
+					bUsed[i] = true;
+					Loop[Count++] = From[i];
+					for (int j = 0; j < Segments; j++)
+					{
+						if (From[j] == To[i]) { i = j; break; }
+					}
+				}
+
+				for (int i = 1; i + 1 < Count; i++)
+				{
+					Workspace.TransitionMesh.Triangles.Add(Loop[0]);
+					Workspace.TransitionMesh.Triangles.Add(Loop[bHighSide ? i + 1 : i]);
+					Workspace.TransitionMesh.Triangles.Add(Loop[bHighSide ? i : i + 1]);
+				}
+			}
+		}
+	}
+}
+
+template <typename LayoutType>
+int FMCMeshBuilder::GetTransitionVertex(FWorkspace& Workspace, const FVoxelBuffer& Data, const LayoutType Layout, const int Size, const FIntVector& A, const FIntVector& B, const float ValA, const float ValB, const bool bCoarse) const
+{
+	const int Axis = A.X != B.X ? 0 : (A.Y != B.Y ? 1 : 2);
+	FMCMesh& TransitionMesh = Workspace.TransitionMesh;
+	int32& Id = Workspace.BoundaryEdges.FindOrAdd(GetEdgeKey(A, Axis, bCoarse, Size), INDEX_NONE);
+	if (Id == INDEX_NONE)
+	{
+		// Half resolution crossings normally come from the regular cells, this only keeps the mesh closed if one is missing
+		const FVector V = FMarchingCubes::InterpolateVertex(FMarchingCubes::IsoLevel, FVector(A), FVector(B), ValA, ValB);
+		const FEdgeCrossing Crossing = {A, Axis, B[Axis] - A[Axis], FMarchingCubes::GetCrossing(FMarchingCubes::IsoLevel, ValA, ValB)};
+		const int Local = AddVertex(TransitionMesh, Workspace.TransitionCrossings, Data, Layout, Size, V, 1, Crossing);
+		if (bCoarse) TransitionMesh.Vertices[Local] = DisplaceVertex(TransitionMesh.Vertices[Local], (Size - 1) / Step);
+		Id = -2 - Local;
+	}
+	return Id;
+}
+
+FVector FMCMeshBuilder::DisplaceVertex(const FVector& V, const int Cells) const
+{
+	FVector P = V / (VoxelSize * Step);
+
+	// Vertices on a face shared with a neighbour at the same level stay put, the neighbour can't know about our transitions
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		if (P[Axis] == 0 && !EnumHasAnyFlags(Transitions, static_cast<ETransitionFace>(1 << Axis * 2))) return V;
+		if (P[Axis] == Cells && !EnumHasAnyFlags(Transitions, static_cast<ETransitionFace>(2 << Axis * 2))) return V;
+	}
+
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		if (EnumHasAnyFlags(Transitions, static_cast<ETransitionFace>(1 << Axis * 2)) && P[Axis] < 1)
+		{
+			P[Axis] += (1 - P[Axis]) * TransitionWidth;
+		}
+		if (EnumHasAnyFlags(Transitions, static_cast<ETransitionFace>(2 << Axis * 2)) && P[Axis] > Cells - 1)
+		{
+			P[Axis] -= (P[Axis] - (Cells - 1)) * TransitionWidth;
+		}
+	}
+	return P * (VoxelSize * Step);
+}
+
+void FMCMeshBuilder::BuildSlab(const FVoxelBuffer& Data, const int Size, const FVoxelSummary* Summary, FSlab& Slab) const
+{
+	const int Cells = Size - 1;
+	const int Words = GetMaskWords(Size);
+	const bool bSharedBottom = Slab.ZBegin > 0;
+	FMCMesh& Mesh = Slab.Mesh;
+	Mesh.Reset();
+	Slab.Crossings.Reset();
+
+	// Counting pass: classify whole rows of corners at once and keep only the cells the surface passes through,
+	// so the output buffers can be reserved up front and the meshing pass never looks at empty or solid cells.
+	// Layers of blocks the summary knows to be all air or all solid are not even classified.
+	Slab.ActiveCells.Reset();
+	Slab.ActiveCubes.Reset();
+	Slab.BoundaryEdges.Reset();
+	for (int i = 0; i < 2; i++)
+	{
+		Slab.PlaneMasks[i].SetNumUninitialized(Size * Words);
+	}
+	const int Blocks = FMath::DivideAndRoundUp(Cells, FVoxelSummary::BlockSize);
+	Slab.BlockMasks.SetNumUninitialized(Blocks * Words);
+
+	int VertexCount = 0;
+	int IndexCount = 0;
+	int ClassifiedPlane = INDEX_NONE;
+	int BlockZ = INDEX_NONE;
+	bool bMixedBlocks = true;
+	for (int z = Slab.ZBegin; z < Slab.ZEnd; z++) 
+	{
+		if (z / FVoxelSummary::BlockSize != BlockZ)
+		{
+			BlockZ = z / FVoxelSummary::BlockSize;
+			bMixedBlocks = GetBlockMasks(Summary, BlockZ, Size, Slab.BlockMasks.GetData());
+		}
+		if (!bMixedBlocks) continue;
+
+		if (ClassifiedPlane == z)
+		{
+			Swap(Slab.PlaneMasks[0], Slab.PlaneMasks[1]);
+		}
+		else
+		{
+			ClassifyPlane(Data, z, Size, Slab.PlaneMasks[0].GetData());
+		}
+		ClassifyPlane(Data, z + 1, Size, Slab.PlaneMasks[1].GetData());
+		ClassifiedPlane = z + 1;
+
+		for (int y = 0; y < Cells; y++) 
+		{
+			const uint64* R00 = &Slab.PlaneMasks[0][y * Words];
+			const uint64* R10 = &Slab.PlaneMasks[0][(y + 1) * Words];
+			const uint64* R01 = &Slab.PlaneMasks[1][y * Words];
+			const uint64* R11 = &Slab.PlaneMasks[1][(y + 1) * Words];
+			const uint64* BlockMask = &Slab.BlockMasks[y / FVoxelSummary::BlockSize * Words];
+
+			for (int w = 0; w < Words; w++)
+			{
+				uint64 Active = GetMixedCells(R00, R10, R01, R11, w, Words) & BlockMask[w];
+				const int ValidCells = Cells - w * 64;
+				if (ValidCells < 64) Active &= ValidCells > 0 ? (1ull << ValidCells) - 1 : 0;
+
+				while (Active != 0)
+				{
+					const int x = w * 64 + FMath::CountTrailingZeros64(Active);
+					Active &= Active - 1;
+
+					int CubeIndex = 0;
+					if (GetBit(R00, x)) CubeIndex |= 1;
+					if (GetBit(R01, x)) CubeIndex |= 2;
+					if (GetBit(R01, x + 1)) CubeIndex |= 4;
+					if (GetBit(R00, x + 1)) CubeIndex |= 8;
+					if (GetBit(R10, x)) CubeIndex |= 16;
+					if (GetBit(R11, x)) CubeIndex |= 32;
+					if (GetBit(R11, x + 1)) CubeIndex |= 64;
+					if (GetBit(R10, x + 1)) CubeIndex |= 128;
+
+					Slab.ActiveCells.Add(GetIndex(x, y, z, Cells));
+					Slab.ActiveCubes.Add(CubeIndex);
+					IndexCount += FMarchingCubes::GetTriangleCount(CubeIndex) * 3;
+					VertexCount += FMath::CountBits(FMarchingCubes::EdgeTable[CubeIndex] & GetOwnedEdges(x, y, Cells, z == Slab.ZEnd - 1, bSharedBottom && z == Slab.ZBegin));
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		Slab.XEdges[i].Init(INDEX_NONE, Size * Size);
+		Slab.YEdges[i].Init(INDEX_NONE, Size * Size);
+	}
+	Slab.ZEdges.Init(INDEX_NONE, Size * Size);
+
+	if (IndexCount == 0) return;
+
+	Mesh.Vertices.Reserve(VertexCount);
+	Mesh.Normals.Reserve(VertexCount);
+	Mesh.Colors.Reserve(VertexCount);
+	Slab.Crossings.Reserve(VertexCount);
+	Mesh.Triangles.Reserve(IndexCount);
 
-	for (int z = 0; z < Size - 1; z++) 
+	int Layer = Slab.ZBegin;
+	Data.VisitLayout([&](const auto Layout)
 	{
-		for (int y = 0; y < Size - 1; y++) 
+		for (int Cell = 0; Cell < Slab.ActiveCells.Num(); Cell++)
 		{
-			for (int x = 0; x < Size - 1; x++) 
+			const int CubeIndex = Slab.ActiveCubes[Cell];
+			const int CellIndex = Slab.ActiveCells[Cell];
+			const int x = CellIndex % Cells;
+			const int y = CellIndex / Cells % Cells;
+			const int z = CellIndex / (Cells * Cells);
+
+			if (z != Layer)
+			{
+				if (z == Layer + 1)
+				{
+					// The upper plane of the previous layer is the lower plane of this one
+					Swap(Slab.XEdges[0], Slab.XEdges[1]);
+					Swap(Slab.YEdges[0], Slab.YEdges[1]);
+				}
+				else
+				{
+					Slab.XEdges[0].Init(INDEX_NONE, Size * Size);
+					Slab.YEdges[0].Init(INDEX_NONE, Size * Size);
+				}
+				Slab.XEdges[1].Init(INDEX_NONE, Size * Size);
+				Slab.YEdges[1].Init(INDEX_NONE, Size * Size);
+				Slab.ZEdges.Init(INDEX_NONE, Size * Size);
+				Layer = z;
+			}
+
+			GatherDensities(Data, Layout, x, y, z, Size, Slab.W);
+			SetVectors(Slab.Pos, x, y, z);
+
+			const int Edges = FMarchingCubes::EdgeTable[CubeIndex];
+			int32 EdgeVertices[12];
+			for (int Edge = 0; Edge < 12; Edge++)
 			{
-				W[0] = Data[GetIndex(x,     y,     z,     Size)].Density;
-				W[1] = Data[GetIndex(x,     y,     z + 1, Size)].Density;
-				W[2] = Data[GetIndex(x + 1, y,     z + 1, Size)].Density;
-				W[3] = Data[GetIndex(x + 1, y,     z,     Size)].Density;
-				W[4] = Data[GetIndex(x,     y + 1, z,     Size)].Density;
-				W[5] = Data[GetIndex(x,     y + 1, z + 1, Size)].Density;
-				W[6] = Data[GetIndex(x + 1, y + 1, z + 1, Size)].Density;
-				W[7] = Data[GetIndex(x + 1, y + 1, z,     Size)].Density;
-
-				SetVectors(Pos, x, y, z);
-				MarchingCubes.InsertTrianglesOfCube(Pos, W, NewTriangles);
+				if (Edges & (1 << Edge)) EdgeVertices[Edge] = GetEdgeVertex(Slab, Data, Layout, Size, Edge, x, y, z);
 			}
+			FMarchingCubes::InsertTrianglesOfCube(CubeIndex, EdgeVertices, Mesh.Triangles);
 		}
+	});
+
+	// The next slab resolves its lower plane against our upper plane, which only holds vertices of the last layer
+	if (Layer != Slab.ZEnd - 1)
+	{
+		Slab.XEdges[1].Init(INDEX_NONE, Size * Size);
+		Slab.YEdges[1].Init(INDEX_NONE, Size * Size);
 	}
+}
 
-	for (int i = 0; i < NewTriangles.Num(); i += 3)
+void FMCMeshBuilder::StitchSlab(FWorkspace& Workspace, const int Index, FVoxelMeshOutput& Output, const bool bAppendVertices)
+{
+	// Vertices on the plane between two slabs belong to the lower one and are referenced by the upper one as shared ids
+	FSlabPart& Part = Parts[Index];
+	if (bAppendVertices)
 	{
-		AddTriangle(NewTriangles[i], NewTriangles[i + 1], NewTriangles[i + 2]);
+		const FSlab& Slab = Workspace.Slabs[Index];
+		Output.AppendVertices(Slab.Mesh, Part.OutputVertices);
+		for (const TPair<int64, int32>& Edge : Slab.BoundaryEdges) Workspace.BoundaryEdges.Add(Edge.Key, Part.OutputVertices[Edge.Value]);
+		Part.Triangles.Reset();
+		Part.Triangles.Append(Slab.Mesh.Triangles);
+
+		// Edge ids stay behind in the workspace, keep what it takes to stitch the slab above again in a later build
+		Part.TopVertices.Reset();
+		for (int i = 0; Index + 1 < Parts.Num() && i < Slab.XEdges[1].Num(); i++)
+		{
+			if (Slab.XEdges[1][i] != INDEX_NONE) Part.TopVertices.Emplace(i * 2, Part.OutputVertices[Slab.XEdges[1][i]]);
+			if (Slab.YEdges[1][i] != INDEX_NONE) Part.TopVertices.Emplace(i * 2 + 1, Part.OutputVertices[Slab.YEdges[1][i]]);
+		}
 	}
 
-	for (int i = 0; i < IndexToVertex.Num(); i++)
+	TArray<int>& OutputIndices = Workspace.OutputIndices;
+	OutputIndices.SetNumUninitialized(Part.Triangles.Num());
+	for (int i = 0; i < Part.Triangles.Num(); i++)
 	{
-		const FVector* v = IndexToVertex.Find(i);
+		const int Local = Part.Triangles[i];
+		if (Local >= 0)
+		{
+			OutputIndices[i] = Part.OutputVertices[Local];
+		}
+		else
+		{
+			const TArray<TPair<int32, int32>>& Below = Parts[Index - 1].TopVertices;
+			OutputIndices[i] = Below[Algo::BinarySearchBy(Below, -2 - Local, [](const TPair<int32, int32>& Vertex) { return Vertex.Key; })].Value;
+		}
+	}
+	Output.AppendTriangles(OutputIndices, Part.OutputTriangles);
+}
 
-		const int x_idx = FMath::Clamp(FMath::RoundToInt(v->X), 0, Size - 1);
-		const int y_idx = FMath::Clamp(FMath::RoundToInt(v->Y), 0, Size - 1);
-		const int z_idx = FMath::Clamp(FMath::RoundToInt(v->Z), 0, Size - 1);
+bool FMCMeshBuilder::GetBlockMasks(const FVoxelSummary* Summary, const int BlockZ, const int Size, uint64* OutMasks) const
+{
+	static_assert(64 % FVoxelSummary::BlockSize == 0, "A block of cells has to fit in a single mask word");
 
-		// Material
-		const FVoxel Voxel = Data[GetIndex(x_idx, y_idx, z_idx, Size)];
-		Mesh.Colors.Add(UVoxelMaterial::Encode(Voxel.Id));
+	const int Words = GetMaskWords(Size);
+	const int Blocks = FMath::DivideAndRoundUp(Size - 1, FVoxelSummary::BlockSize);
+	if (!Summary)
+	{
+		FMemory::Memset(OutMasks, 0xFF, Blocks * Words * sizeof(uint64));
+		return true;
+	}
+
+	bool bAnyMixed = false;
+	FMemory::Memzero(OutMasks, Blocks * Words * sizeof(uint64));
+	for (int y = 0; y < Blocks; y++)
+	{
+		uint64* Mask = OutMasks + y * Words;
+		for (int x = 0; x < Blocks; x++)
+		{
+			if (!Summary->IsBlockMixed(x, y, BlockZ, FMarchingCubes::IsoLevel)) continue;
 
-		const int x_minus = FMath::Max(0, x_idx - 1);
-		const int x_plus = FMath::Min(Size - 1, x_idx + 1);
-		const int y_minus = FMath::Max(0, y_idx - 1);
-		const int y_plus = FMath::Min(Size - 1, y_idx + 1);
-		const int z_minus = FMath::Max(0, z_idx - 1);
-		const int z_plus = FMath::Min(Size - 1, z_idx + 1);
-		
-		FVector Grad;
-		Grad.X = Data[GetIndex(x_minus, y_idx, z_idx, Size)].Density - Data[GetIndex(x_plus, y_idx, z_idx, Size)].Density;
-		Grad.Y = Data[GetIndex(x_idx, y_minus, z_idx, Size)].Density - Data[GetIndex(x_idx, y_plus, z_idx, Size)].Density;
-		Grad.Z = Data[GetIndex(x_idx, z_idx, z_minus, Size)].Density - Data[GetIndex(x_idx, z_idx, z_plus, Size)].Density;
-		Mesh.Normals.Add(-Grad.GetSafeNormal());
-		
-		// Vertex
-		Mesh.Vertices.Add(FVector(v->X * VoxelSize, v->Y * VoxelSize, v->Z * VoxelSize));
+			const int FirstCell = x * FVoxelSummary::BlockSize;
+			Mask[FirstCell >> 6] |= ((1ull << FVoxelSummary::BlockSize) - 1) << (FirstCell & 63);
+			bAnyMixed = true;
+		}
 	}
-	
-	for (int i = 0; i < Triangles.Num(); i++)
+	return bAnyMixed;
+}
+
+void FMCMeshBuilder::ClassifyPlane(const FVoxelBuffer& Data, const int Z, const int Size, uint64* OutMasks) const
+{
+	const int Words = GetMaskWords(Size);
+	// Compared on the stored values, which sort the same way the densities they stand for do
+	const int16 Iso = FVoxelBuffer::QuantizeIsoLevel(FMarchingCubes::IsoLevel);
+
+	for (int y = 0; y < Size; y++)
 	{
-		Mesh.Triangles.Add(Triangles[i]);
+		uint64* Mask = OutMasks + y * Words;
+		FMemory::Memzero(Mask, Words * sizeof(uint64));
+
+		if (Data.Layout == EVoxelLayout::Linear)
+		{
+			// A contiguous run of int16 without branches, which the compiler turns into wide compares
+			const int16* Row = &Data.Densities[GetIndex(0, y, Z, Size)];
+			for (int x = 0; x < Size; x++)
+			{
+				Mask[x >> 6] |= static_cast<uint64>(Row[x] < Iso) << (x & 63);
+			}
+			continue;
+		}
+		for (int x = 0; x < Size; x++)
+		{
+			Mask[x >> 6] |= static_cast<uint64>(Data.Densities[FBrickVoxelLayout::GetIndex(x, y, Z, Size)] < Iso) << (x & 63);
+		}
 	}
+}
 
-	return Mesh;
+uint64 FMCMeshBuilder::GetMixedCells(const uint64* R00, const uint64* R10, const uint64* R01, const uint64* R11, const int Word, const int Words)
+{
+	// Bit x is set when the eight corners of cell x are neither all inside nor all outside.
+	// The corners at x + 1 come from shifting the rows down by one, pulling in the first bit of the next word.
+	const uint64 Any = R00[Word] | R10[Word] | R01[Word] | R11[Word];
+	const uint64 All = R00[Word] & R10[Word] & R01[Word] & R11[Word];
+	uint64 AnyNext = Any >> 1;
+	uint64 AllNext = All >> 1;
+	if (Word + 1 < Words)
+	{
+		AnyNext |= (R00[Word + 1] | R10[Word + 1] | R01[Word + 1] | R11[Word + 1]) << 63;
+		AllNext |= (R00[Word + 1] & R10[Word + 1] & R01[Word + 1] & R11[Word + 1]) << 63;
+	}
+	return (Any | AnyNext) & ~(All & AllNext);
+}
+
+template <typename LayoutType>
+void FMCMeshBuilder::GatherDensities(const FVoxelBuffer& Data, const LayoutType Layout, const int X, const int Y, const int Z, const int Size, float* W)
+{
+	W[0] = Data.GetDensity(Layout.GetIndex(X,     Y,     Z,     Size));
+	W[1] = Data.GetDensity(Layout.GetIndex(X,     Y,     Z + 1, Size));
+	W[2] = Data.GetDensity(Layout.GetIndex(X + 1, Y,     Z + 1, Size));
+	W[3] = Data.GetDensity(Layout.GetIndex(X + 1, Y,     Z,     Size));
+	W[4] = Data.GetDensity(Layout.GetIndex(X,     Y + 1, Z,     Size));
+	W[5] = Data.GetDensity(Layout.GetIndex(X,     Y + 1, Z + 1, Size));
+	W[6] = Data.GetDensity(Layout.GetIndex(X + 1, Y + 1, Z + 1, Size));
+	W[7] = Data.GetDensity(Layout.GetIndex(X + 1, Y + 1, Z,     Size));
 }
 
 void FMCMeshBuilder::SetVectors(FVector* V, const float X, const float Y, const float Z)
@@ -149,42 +707,184 @@ void FMCMeshBuilder::SetVectors(FVector* V, const float X, const float Y, const
 	V[1].Z = V[2].Z = V[5].Z = V[6].Z = Z + 1;
 }
 
-void FMCMeshBuilder::AddTriangle(const FVector V1, const FVector V2, const FVector V3)
+template <typename LayoutType>
+int FMCMeshBuilder::GetEdgeVertex(FSlab& Slab, const FVoxelBuffer& Data, const LayoutType Layout, const int Size, const int Edge, const int X, const int Y, const int Z) const
+{
+	const int Start = CubeEdges[Edge][0];
+	const int End = CubeEdges[Edge][1];
+	const int Axis = CubeEdges[Edge][2];
+	const int Plane = CornerOffsets[Start][2];
+	const int PlaneIndex = (Y + CornerOffsets[Start][1]) * Size + X + CornerOffsets[Start][0];
+
+	// X/Y edges on the bottom plane of a slab are created by the slab below, emit a shared id for StitchSlab to resolve
+	if (Axis != 2 && Plane == 0 && Z == Slab.ZBegin && Slab.ZBegin > 0)
+	{
+		return -2 - (PlaneIndex * 2 + Axis);
+	}
+
+	int32& Id = Axis == 2 ? Slab.ZEdges[PlaneIndex] : (Axis == 0 ? Slab.XEdges : Slab.YEdges)[Plane][PlaneIndex];
+	if (Id == INDEX_NONE)
+	{
+		const FIntVector Lower(X + CornerOffsets[Start][0], Y + CornerOffsets[Start][1], Z + CornerOffsets[Start][2]);
+		const FEdgeCrossing Crossing = {Lower * Step, Axis, Step, FMarchingCubes::GetCrossing(FMarchingCubes::IsoLevel, Slab.W[Start], Slab.W[End])};
+		Id = AddVertex(Slab.Mesh, Slab.Crossings, Data, Layout, Size, FMarchingCubes::InterpolateVertex(FMarchingCubes::IsoLevel, Slab.Pos[Start], Slab.Pos[End], Slab.W[Start], Slab.W[End]), Step, Crossing);
+
+		// Crossings on the chunk faces are the half resolution side of the transition cells
+		if (Transitions != ETransitionFace::None && ((Axis != 0 && Lower.X % (Size - 1) == 0) || (Axis != 1 && Lower.Y % (Size - 1) == 0) || (Axis != 2 && Lower.Z % (Size - 1) == 0)))
+		{
+			Slab.BoundaryEdges.Emplace(GetEdgeKey(Lower * Step, Axis, true, (Size - 1) * Step + 1), Id);
+		}
+	}
+	return Id;
+}
+
+template <typename LayoutType>
+int FMCMeshBuilder::AddVertex(FMCMesh& Mesh, TArray<FEdgeCrossing>& Crossings, const FVoxelBuffer& Data, const LayoutType Layout, const int Size, const FVector& V, const int VertexStep, const FEdgeCrossing& Crossing)
 {
-	const FVector Normal = ComputeNormal(V1, V2, V3);
+	const int x_idx = FMath::Clamp(FMath::RoundToInt(V.X), 0, Size - 1);
+	const int y_idx = FMath::Clamp(FMath::RoundToInt(V.Y), 0, Size - 1);
+	const int z_idx = FMath::Clamp(FMath::RoundToInt(V.Z), 0, Size - 1);
+
+	// Material
+	Mesh.Colors.Add(UVoxelMaterial::Encode(Data.Materials[Layout.GetIndex(x_idx, y_idx, z_idx, Size)]));
+
+	// Normal, once the mesh is done
+	Crossings.Add(Crossing);
+
+	// Vertex
+	const float Scale = VoxelSize * VertexStep;
+	return Mesh.Vertices.Add(FVector(V.X * Scale, V.Y * Scale, V.Z * Scale));
+}
 
-	Triangles.Add(InsertVertex(V1, Normal));
-	Triangles.Add(InsertVertex(V2, Normal));
-	Triangles.Add(InsertVertex(V3, Normal));
+void FMCMeshBuilder::ComputeNormals(const FVoxelMeshInput& Input, const TArray<FEdgeCrossing>& Crossings, TArray<FVector3f>& OutNormals)
+{
+	Input.Voxels->VisitLayout([&](const auto Layout) { ComputeNormals(Input, Layout, Crossings, OutNormals); });
 }
 
-int FMCMeshBuilder::InsertVertex(const FVector V, const FVector Normal)
+template <typename LayoutType>
+void FMCMeshBuilder::ComputeNormals(const FVoxelMeshInput& Input, const LayoutType Layout, const TArray<FEdgeCrossing>& Crossings, TArray<FVector3f>& OutNormals)
 {
-	int i = 0;
-	if (!VertexToIndex.Contains(V)) {
-		i = IndexToVertex.Num();
-		IndexToVertex.Add(i, V);
-		VertexToIndex.Add(V, i);
-		IndexToNormal.Add(i, FVector());
+	// The density gradient is taken at both ends of the crossed edge and interpolated to where the vertex sits on it.
+	// Four vertices at a time: the differences are gathered one by one, blending and normalizing runs on all four at once.
+	OutNormals.SetNumUninitialized(Crossings.Num());
+	const VectorRegister4Float MinLengthSquared = VectorSetFloat1(UE_SMALL_NUMBER);
+	for (int First = 0; First < Crossings.Num(); First += 4)
+	{
+		const int Count = FMath::Min(4, Crossings.Num() - First);
+		alignas(16) float Lower[3][4] = {};
+		alignas(16) float Upper[3][4] = {};
+		alignas(16) float T[4] = {};
+		for (int Lane = 0; Lane < Count; Lane++)
+		{
+			const FEdgeCrossing& Crossing = Crossings[First + Lane];
+			FIntVector UpperEnd = Crossing.Lower;
+			UpperEnd[Crossing.Axis] += Crossing.Step;
+			for (int Axis = 0; Axis < 3; Axis++)
+			{
+				Lower[Axis][Lane] = GetDifference(Input, Layout, Crossing.Lower, Axis, Crossing.Step);
+				Upper[Axis][Lane] = GetDifference(Input, Layout, UpperEnd, Axis, Crossing.Step);
+			}
+			T[Lane] = Crossing.T;
+		}
+
+		const VectorRegister4Float Mu = VectorLoadAligned(T);
+		VectorRegister4Float Gradient[3];
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			const VectorRegister4Float A = VectorLoadAligned(Lower[Axis]);
+			Gradient[Axis] = VectorMultiplyAdd(Mu, VectorSubtract(VectorLoadAligned(Upper[Axis]), A), A);
+		}
+
+		// Same cut-off as GetSafeNormal, a vertex without a gradient gets a zero normal
+		const VectorRegister4Float LengthSquared = VectorMultiplyAdd(Gradient[0], Gradient[0], VectorMultiplyAdd(Gradient[1], Gradient[1], VectorMultiply(Gradient[2], Gradient[2])));
+		const VectorRegister4Float Scale = VectorSelect(VectorCompareGT(LengthSquared, MinLengthSquared), VectorDivide(GlobalVectorConstants::FloatOne, VectorSqrt(LengthSquared)), GlobalVectorConstants::FloatZero);
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			VectorStoreAligned(VectorMultiply(Gradient[Axis], Scale), Lower[Axis]);
+		}
+		for (int Lane = 0; Lane < Count; Lane++)
+		{
+			OutNormals[First + Lane] = FVector3f(Lower[0][Lane], Lower[1][Lane], Lower[2][Lane]);
+		}
 	}
-	else {
-		i = *VertexToIndex.Find(V);
+}
+
+template <typename LayoutType>
+float FMCMeshBuilder::GetDifference(const FVoxelMeshInput& Input, const LayoutType Layout, const FIntVector& Voxel, const int Axis, const int Distance)
+{
+	// Central difference, one-sided and doubled where the chunk past the face is missing
+	FIntVector Below = Voxel;
+	FIntVector Above = Voxel;
+	Below[Axis] -= Distance;
+	Above[Axis] += Distance;
+	float LowDensity = 0;
+	float HighDensity = 0;
+	const bool bLow = FindDensity(Input, Layout, Below, Axis, LowDensity);
+	const bool bHigh = FindDensity(Input, Layout, Above, Axis, HighDensity);
+	if (bLow && bHigh) return HighDensity - LowDensity;
+
+	const float Center = Input.Voxels->GetDensity(Layout.GetIndex(Voxel.X, Voxel.Y, Voxel.Z, Input.Size));
+	return bLow ? 2 * (Center - LowDensity) : 2 * (HighDensity - Center);
+}
+
+template <typename LayoutType>
+bool FMCMeshBuilder::FindDensity(const FVoxelMeshInput& Input, const LayoutType Layout, FIntVector Voxel, const int Axis, float& OutDensity)
+{
+	// Only ever off the chunk along one axis, the chunk past that face shares the face voxels with this one
+	const int Cells = Input.Size - 1;
+	const FVoxelNeighbour* Neighbour;
+	if (Voxel[Axis] < 0)
+	{
+		Neighbour = &Input.LowNeighbours[Axis];
+		Voxel[Axis] += Cells;
+	}
+	else if (Voxel[Axis] > Cells)
+	{
+		Neighbour = &Input.Neighbours[1 << Axis];
+		Voxel[Axis] -= Cells;
 	}
+	else
+	{
+		OutDensity = Input.Voxels->GetDensity(Layout.GetIndex(Voxel.X, Voxel.Y, Voxel.Z, Input.Size));
+		return true;
+	}
+	if (!*Neighbour) return false;
+	OutDensity = Neighbour->GetVoxel(Voxel.X, Voxel.Y, Voxel.Z, Axis).Density;
+	return true;
+}
 
-	IndexToNormal.Add(i, *IndexToNormal.Find(i) + Normal);
+int FMCMeshBuilder::GetOwnedEdges(const int X, const int Y, const int Cells, const bool bTopLayer, const bool bSharedBottom)
+{
+	// Every grid edge is counted by the cell at its lower end; cells on the upper faces also count the edges nobody else starts.
+	// The bottom plane of a slab above another one is counted by the slab below as its top layer.
+	const bool bLastX = X == Cells - 1;
+	const bool bLastY = Y == Cells - 1;
 
-	return i;
+	int Edges = bSharedBottom ? 0x001 : 0x109;
+	if (bLastX) Edges |= bSharedBottom ? 0x004 : 0x804;
+	if (bLastY) Edges |= bSharedBottom ? 0x010 : 0x090;
+	if (bTopLayer) Edges |= 0x202;
+	if (bLastX && bLastY) Edges |= 0x040;
+	if (bLastX && bTopLayer) Edges |= 0x400;
+	if (bLastY && bTopLayer) Edges |= 0x020;
+	return Edges;
 }
 
-FVector FMCMeshBuilder::ComputeNormal(const FVector V1, const FVector V2, const FVector V3)
+int FMCMeshBuilder::GetMaskWords(const int Size)
 {
-	FVector E1 = FVector(V2.X, V2.Y, V2.Z);
-	FVector E2 = FVector(V3.X, V3.Y, V3.Z);
-	E1 = E1 - V1;
-	E2 = E2 - V1;
-	return FVector::CrossProduct(E1, E2).GetSafeNormal();
+	return (Size + 63) >> 6;
+}
+
+bool FMCMeshBuilder::GetBit(const uint64* Mask, const int X)
+{
+	return (Mask[X >> 6] >> (X & 63)) & 1;
 }
 
 int FMCMeshBuilder::GetIndex(const int X, const int Y, const int Z, const int Size) {
 	return ((Z * Size * Size) + (Y * Size) + X);
+}
+
+int64 FMCMeshBuilder::GetEdgeKey(const FIntVector& Lower, const int Axis, const bool bCoarse, const int Size)
+{
+	return (static_cast<int64>(GetIndex(Lower.X, Lower.Y, Lower.Z, Size)) * 3 + Axis) * 2 + (bCoarse ? 1 : 0);
 }
\ No newline at end of file
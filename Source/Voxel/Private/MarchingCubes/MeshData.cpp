@@ -3,3 +3,11 @@
 FMCMesh::FMCMesh()
 {
 }
+
+void FMCMesh::Reset()
+{
+	Vertices.Reset();
+	Normals.Reset();
+	Colors.Reset();
+	Triangles.Reset();
+}
@@ -0,0 +1,283 @@
+﻿#include "MarchingCubes/MeshDecimator.h"
+
+FMeshDecimator::FMeshDecimator(FMCMesh& InMesh, const FBox& InBounds)
+	: Mesh(InMesh)
+	, Bounds(InBounds)
+{
+}
+
+void FMeshDecimator::Decimate(const int TargetTriangleCount)
+{
+	int TriangleCount = Mesh.Triangles.Num() / 3;
+	if (TriangleCount <= TargetTriangleCount) return;
+	Init();
+
+	FCollapse Next;
+	while (TriangleCount > TargetTriangleCount && Heap.Num() > 0)
+	{
+		Heap.HeapPop(Next, EAllowShrinking::No);
+		if (Stamps[Next.From] != Next.FromStamp || Stamps[Next.To] != Next.ToStamp) continue;
+		if (!CanCollapse(Next.From, Next.To)) continue;
+
+		TriangleCount -= Collapse(Next.From, Next.To);
+		QueueNeighbours(Next.To);
+	}
+	Compact();
+}
+
+void FMeshDecimator::FQuadric::AddPlane(const FVector& Normal, const double W, const double Weight)
+{
+	XX += Weight * Normal.X * Normal.X;
+	XY += Weight * Normal.X * Normal.Y;
+	XZ += Weight * Normal.X * Normal.Z;
+	XW += Weight * Normal.X * W;
+	YY += Weight * Normal.Y * Normal.Y;
+	YZ += Weight * Normal.Y * Normal.Z;
+	YW += Weight * Normal.Y * W;
+	ZZ += Weight * Normal.Z * Normal.Z;
+	ZW += Weight * Normal.Z * W;
+	WW += Weight * W * W;
+}
+
+void FMeshDecimator::FQuadric::Add(const FQuadric& Other)
+{
+	XX += Other.XX;
+	XY += Other.XY;
+	XZ += Other.XZ;
+	XW += Other.XW;
+	YY += Other.YY;
+	YZ += Other.YZ;
+	YW += Other.YW;
+	ZZ += Other.ZZ;
+	ZW += Other.ZW;
+	WW += Other.WW;
+}
+
+double FMeshDecimator::FQuadric::Evaluate(const FVector& P) const
+{
+	return XX * P.X * P.X + 2 * XY * P.X * P.Y + 2 * XZ * P.X * P.Z + 2 * XW * P.X
+		+ YY * P.Y * P.Y + 2 * YZ * P.Y * P.Z + 2 * YW * P.Y
+		+ ZZ * P.Z * P.Z + 2 * ZW * P.Z
+		+ WW;
+}
+
+void FMeshDecimator::Init()
+{
+	const int NumVertices = Mesh.Vertices.Num();
+	const int NumTriangles = Mesh.Triangles.Num() / 3;
+	Quadrics.Init(FQuadric(), NumVertices);
+	VertexTriangles.SetNum(NumVertices);
+	Stamps.Init(0, NumVertices);
+	RemovedTriangles.Init(false, NumTriangles);
+
+	for (int Triangle = 0; Triangle < NumTriangles; Triangle++)
+	{
+		const int* Corners = &Mesh.Triangles[Triangle * 3];
+		const FVector& A = Mesh.Vertices[Corners[0]];
+		const FVector Cross = FVector::CrossProduct(Mesh.Vertices[Corners[1]] - A, Mesh.Vertices[Corners[2]] - A);
+		const double DoubleArea = Cross.Size();
+		FQuadric Plane;
+		if (DoubleArea > UE_DOUBLE_SMALL_NUMBER)
+		{
+			const FVector Normal = Cross / DoubleArea;
+			Plane.AddPlane(Normal, -FVector::DotProduct(Normal, A), DoubleArea * 0.5);
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			Quadrics[Corners[i]].Add(Plane);
+			VertexTriangles[Corners[i]].Add(Triangle);
+		}
+	}
+
+	LockVertices();
+}
+
+void FMeshDecimator::LockVertices()
+{
+	Locked.Init(false, Mesh.Vertices.Num());
+	for (int i = 0; i < Mesh.Vertices.Num(); i++)
+	{
+		if (IsOnBounds(Mesh.Vertices[i])) Locked[i] = true;
+	}
+
+	// Every edge once per triangle it belongs to, sorted so the copies of an edge end up next to each other
+	TArray<uint64> Edges;
+	Edges.Reserve(Mesh.Triangles.Num());
+	for (int i = 0; i < Mesh.Triangles.Num(); i += 3)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			const uint32 A = Mesh.Triangles[i + j];
+			const uint32 B = Mesh.Triangles[i + (j + 1) % 3];
+			Edges.Add(static_cast<uint64>(FMath::Min(A, B)) << 32 | FMath::Max(A, B));
+		}
+	}
+	Edges.Sort();
+
+	int First = 0;
+	while (First < Edges.Num())
+	{
+		int End = First + 1;
+		while (End < Edges.Num() && Edges[End] == Edges[First]) End++;
+
+		const int32 A = static_cast<int32>(Edges[First] >> 32);
+		const int32 B = static_cast<int32>(Edges[First] & 0xFFFFFFFF);
+		if (End - First != 2 || Mesh.Colors[A] != Mesh.Colors[B])
+		{
+			Locked[A] = true;
+			Locked[B] = true;
+		}
+		First = End;
+	}
+
+	// Queued once the locks are known, locked vertices can still be collapsed onto
+	for (int i = 0; i < Edges.Num(); i++)
+	{
+		if (i > 0 && Edges[i] == Edges[i - 1]) continue;
+		QueueCollapses(static_cast<int32>(Edges[i] >> 32), static_cast<int32>(Edges[i] & 0xFFFFFFFF));
+	}
+}
+
+bool FMeshDecimator::IsOnBounds(const FVector& P) const
+{
+	constexpr double Tolerance = 1e-3;
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		if (P[Axis] <= Bounds.Min[Axis] + Tolerance || P[Axis] >= Bounds.Max[Axis] - Tolerance) return true;
+	}
+	return false;
+}
+
+void FMeshDecimator::QueueCollapses(const int32 A, const int32 B)
+{
+	FQuadric Sum = Quadrics[A];
+	Sum.Add(Quadrics[B]);
+	if (!Locked[A]) Heap.HeapPush({Sum.Evaluate(Mesh.Vertices[B]), A, B, Stamps[A], Stamps[B]});
+	if (!Locked[B]) Heap.HeapPush({Sum.Evaluate(Mesh.Vertices[A]), B, A, Stamps[B], Stamps[A]});
+}
+
+void FMeshDecimator::QueueNeighbours(const int32 Vertex)
+{
+	// The quadric of the vertex changed, so did the cost of every edge it is on
+	Stamps[Vertex]++;
+	TArray<int32, TInlineAllocator<16>> Neighbours;
+	GetNeighbours(Vertex, Neighbours);
+	for (const int32 Neighbour : Neighbours)
+	{
+		QueueCollapses(Vertex, Neighbour);
+	}
+}
+
+void FMeshDecimator::GetNeighbours(const int32 Vertex, TArray<int32, TInlineAllocator<16>>& OutNeighbours) const
+{
+	OutNeighbours.Reset();
+	for (const int32 Triangle : VertexTriangles[Vertex])
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			const int32 Corner = Mesh.Triangles[Triangle * 3 + i];
+			if (Corner != Vertex) OutNeighbours.AddUnique(Corner);
+		}
+	}
+}
+
+bool FMeshDecimator::CanCollapse(const int32 From, const int32 To) const
+{
+	// The two triangles on the edge go away, any other vertex next to both ends would leave a non-manifold edge behind
+	TArray<int32, TInlineAllocator<16>> FromNeighbours;
+	TArray<int32, TInlineAllocator<16>> ToNeighbours;
+	GetNeighbours(From, FromNeighbours);
+	GetNeighbours(To, ToNeighbours);
+	int Shared = 0;
+	for (const int32 Neighbour : FromNeighbours)
+	{
+		if (ToNeighbours.Contains(Neighbour)) Shared++;
+	}
+	if (Shared != 2) return false;
+
+	const FVector& Target = Mesh.Vertices[To];
+	for (const int32 Triangle : VertexTriangles[From])
+	{
+		const int* Corners = &Mesh.Triangles[Triangle * 3];
+		if (Corners[0] == To || Corners[1] == To || Corners[2] == To) continue;
+
+		FVector Before[3];
+		FVector After[3];
+		for (int i = 0; i < 3; i++)
+		{
+			Before[i] = Mesh.Vertices[Corners[i]];
+			After[i] = Corners[i] == From ? Target : Before[i];
+		}
+		const FVector OldNormal = FVector::CrossProduct(Before[1] - Before[0], Before[2] - Before[0]).GetSafeNormal();
+		if (OldNormal.IsZero()) continue;
+		const FVector NewNormal = FVector::CrossProduct(After[1] - After[0], After[2] - After[0]);
+		const double NewLength = NewNormal.Size();
+		if (NewLength <= UE_DOUBLE_SMALL_NUMBER) return false;
+		if (FVector::DotProduct(OldNormal, NewNormal / NewLength) < MinNormalCosine) return false;
+	}
+	return true;
+}
+
+int FMeshDecimator::Collapse(const int32 From, const int32 To)
+{
+	int Removed = 0;
+	for (const int32 Triangle : VertexTriangles[From])
+	{
+		int* Corners = &Mesh.Triangles[Triangle * 3];
+		if (Corners[0] == To || Corners[1] == To || Corners[2] == To)
+		{
+			RemovedTriangles[Triangle] = true;
+			Removed++;
+			for (int i = 0; i < 3; i++)
+			{
+				if (Corners[i] != From) VertexTriangles[Corners[i]].RemoveSingleSwap(Triangle);
+			}
+			continue;
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (Corners[i] == From) Corners[i] = To;
+		}
+		VertexTriangles[To].Add(Triangle);
+	}
+
+	VertexTriangles[From].Empty();
+	Quadrics[To].Add(Quadrics[From]);
+	Stamps[From] = INDEX_NONE;
+	return Removed;
+}
+
+void FMeshDecimator::Compact()
+{
+	// Vertices keep their order, so each one only ever moves down and the arrays can be packed in place
+	TArray<int32> Remap;
+	Remap.Init(INDEX_NONE, Mesh.Vertices.Num());
+	for (int Triangle = 0; Triangle < RemovedTriangles.Num(); Triangle++)
+	{
+		if (RemovedTriangles[Triangle]) continue;
+		for (int i = 0; i < 3; i++) Remap[Mesh.Triangles[Triangle * 3 + i]] = 0;
+	}
+
+	int NumVertices = 0;
+	for (int i = 0; i < Remap.Num(); i++)
+	{
+		if (Remap[i] == INDEX_NONE) continue;
+		Remap[i] = NumVertices;
+		Mesh.Vertices[NumVertices] = Mesh.Vertices[i];
+		Mesh.Normals[NumVertices] = Mesh.Normals[i];
+		Mesh.Colors[NumVertices] = Mesh.Colors[i];
+		NumVertices++;
+	}
+	Mesh.Vertices.SetNum(NumVertices);
+	Mesh.Normals.SetNum(NumVertices);
+	Mesh.Colors.SetNum(NumVertices);
+
+	int NumIndices = 0;
+	for (int Triangle = 0; Triangle < RemovedTriangles.Num(); Triangle++)
+	{
+		if (RemovedTriangles[Triangle]) continue;
+		for (int i = 0; i < 3; i++) Mesh.Triangles[NumIndices++] = Remap[Mesh.Triangles[Triangle * 3 + i]];
+	}
+	Mesh.Triangles.SetNum(NumIndices);
+}
@@ -0,0 +1,59 @@
+﻿#include "MarchingCubes/VoxelBufferPool.h"
+
+FVoxelBufferPool& FVoxelBufferPool::Get()
+{
+	static FVoxelBufferPool Pool;
+	return Pool;
+}
+
+void FVoxelBufferPool::Allocate(FVoxelBuffer& Buffer, const int Size, const EVoxelLayout Layout)
+{
+	const int Count = FVoxelBuffer::GetNumVoxels(Size, Layout);
+	if (Buffer.Num() != Count)
+	{
+		Release(Buffer);
+		FScopeLock ScopeLock(&Lock);
+		TArray<FVoxelBuffer>* Free = FreeBuffers.Find(Count);
+		if (Free && Free->Num() > 0)
+		{
+			Buffer = Free->Pop(EAllowShrinking::No);
+		}
+	}
+	Buffer.Init(Size, Layout);
+}
+
+void FVoxelBufferPool::Release(FVoxelBuffer& Buffer)
+{
+	if (Buffer.Num() == 0) return;
+	{
+		FScopeLock ScopeLock(&Lock);
+		TArray<FVoxelBuffer>& Free = FreeBuffers.FindOrAdd(Buffer.Num());
+		if (Free.Num() < MaxFreeBuffers)
+		{
+			Free.Add(MoveTemp(Buffer));
+		}
+	}
+	Buffer.Empty();
+}
+
+TSharedRef<FVoxelBuffer, ESPMode::ThreadSafe> FVoxelBufferPool::AllocateShared(const int Size, const EVoxelLayout Layout)
+{
+	FVoxelBuffer* Buffer = new FVoxelBuffer();
+	Allocate(*Buffer, Size, Layout);
+	return TSharedRef<FVoxelBuffer, ESPMode::ThreadSafe>(Buffer, [](FVoxelBuffer* Released)
+	{
+		Get().Release(*Released);
+		delete Released;
+	});
+}
+
+int64 FVoxelBufferPool::GetFreeBytes() const
+{
+	FScopeLock ScopeLock(&Lock);
+	int64 Bytes = 0;
+	for (const TPair<int, TArray<FVoxelBuffer>>& Pair : FreeBuffers)
+	{
+		for (const FVoxelBuffer& Buffer : Pair.Value) Bytes += Buffer.GetAllocatedSize();
+	}
+	return Bytes;
+}
@@ -4,3 +4,104 @@ FVoxel::FVoxel()
 {
 	
 }
+
+void FVoxelBuffer::Init(const int InSize, const EVoxelLayout InLayout)
+{
+	Size = InSize;
+	Layout = InLayout;
+	const int Count = GetNumVoxels(Size, Layout);
+	Densities.SetNumUninitialized(Count);
+	Materials.SetNumUninitialized(Count);
+}
+
+int FVoxelBuffer::GetNumVoxels(const int InSize, const EVoxelLayout InLayout)
+{
+	return InLayout == EVoxelLayout::Bricks ? FBrickVoxelLayout::GetNumVoxels(InSize) : FLinearVoxelLayout::GetNumVoxels(InSize);
+}
+
+void FVoxelBuffer::Empty()
+{
+	Densities.Empty();
+	Materials.Empty();
+	Size = 0;
+}
+
+void FVoxelBuffer::SetVoxel(const int Index, const FVoxel& Voxel)
+{
+	Densities[Index] = QuantizeDensity(Voxel.Density);
+	Materials[Index] = static_cast<uint8>(Voxel.Id);
+}
+
+void FVoxelBuffer::Fill(const FVoxel& Voxel)
+{
+	const int16 Density = QuantizeDensity(Voxel.Density);
+	for (int16& Value : Densities) Value = Density;
+	FMemory::Memset(Materials.GetData(), static_cast<uint8>(Voxel.Id), Materials.Num());
+}
+
+void FVoxelBuffer::CopyVoxels(const FVoxelBuffer& Source)
+{
+	check(Source.Size == Size);
+	if (Source.Layout == Layout)
+	{
+		Densities = Source.Densities;
+		Materials = Source.Materials;
+		return;
+	}
+
+	VisitLayout([&](const auto TargetLayout)
+	{
+		Source.VisitLayout([&](const auto SourceLayout)
+		{
+			for (int z = 0; z < Size; z++)
+			{
+				for (int y = 0; y < Size; y++)
+				{
+					for (int x = 0; x < Size; x++)
+					{
+						const int Index = TargetLayout.GetIndex(x, y, z, Size);
+						const int SourceIndex = SourceLayout.GetIndex(x, y, z, Size);
+						Densities[Index] = Source.Densities[SourceIndex];
+						Materials[Index] = Source.Materials[SourceIndex];
+					}
+				}
+			}
+		});
+	});
+}
+
+bool FVoxelBuffer::IsUniform() const
+{
+	if (Num() == 0) return false;
+	if (Layout == EVoxelLayout::Linear)
+	{
+		const int16 Density = Densities[0];
+		const uint8 Material = Materials[0];
+		for (int i = 1; i < Num(); i++)
+		{
+			if (Densities[i] != Density || Materials[i] != Material) return false;
+		}
+		return true;
+	}
+
+	// The padding of the bricks holds whatever was there before
+	const int16 Density = Densities[GetIndex(0, 0, 0)];
+	const uint8 Material = Materials[GetIndex(0, 0, 0)];
+	for (int z = 0; z < Size; z++)
+	{
+		for (int y = 0; y < Size; y++)
+		{
+			for (int x = 0; x < Size; x++)
+			{
+				const int Index = FBrickVoxelLayout::GetIndex(x, y, z, Size);
+				if (Densities[Index] != Density || Materials[Index] != Material) return false;
+			}
+		}
+	}
+	return true;
+}
+
+int16 FVoxelBuffer::QuantizeIsoLevel(const float IsoLevel)
+{
+	return static_cast<int16>(FMath::Clamp(FMath::CeilToInt(IsoLevel / DensityStep), -static_cast<int32>(MAX_int16), static_cast<int32>(MAX_int16)));
+}
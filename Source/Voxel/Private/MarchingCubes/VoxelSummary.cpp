@@ -0,0 +1,121 @@
+﻿#include "MarchingCubes/VoxelSummary.h"
+
+void FVoxelSummary::Init(const int NewSize)
+{
+	Size = NewSize;
+	Blocks = Size > 0 ? FMath::Max(1, FMath::DivideAndRoundUp(Size - 1, BlockSize)) : 0;
+	MinDensity.Init(-UE_BIG_NUMBER, Blocks * Blocks * Blocks);
+	MaxDensity.Init(UE_BIG_NUMBER, Blocks * Blocks * Blocks);
+	ChunkMinDensity = -UE_BIG_NUMBER;
+	ChunkMaxDensity = UE_BIG_NUMBER;
+}
+
+void FVoxelSummary::Update(const FVoxelBuffer& Voxels)
+{
+	Update(Voxels, FIntVector(0), FIntVector(Size - 1));
+}
+
+void FVoxelSummary::Update(const FVoxelBuffer& Voxels, const FIntVector& Min, const FIntVector& Max)
+{
+	if (Blocks == 0) return;
+
+	// Voxels on a block boundary also belong to the block below, which has to be refreshed too
+	const FIntVector First(
+		FMath::Clamp((Min.X - 1) / BlockSize, 0, Blocks - 1),
+		FMath::Clamp((Min.Y - 1) / BlockSize, 0, Blocks - 1),
+		FMath::Clamp((Min.Z - 1) / BlockSize, 0, Blocks - 1));
+	const FIntVector Last(
+		FMath::Clamp(Max.X / BlockSize, 0, Blocks - 1),
+		FMath::Clamp(Max.Y / BlockSize, 0, Blocks - 1),
+		FMath::Clamp(Max.Z / BlockSize, 0, Blocks - 1));
+
+	for (int z = First.Z; z <= Last.Z; z++)
+	{
+		for (int y = First.Y; y <= Last.Y; y++)
+		{
+			for (int x = First.X; x <= Last.X; x++)
+			{
+				UpdateBlock(Voxels, x, y, z);
+			}
+		}
+	}
+
+	ChunkMinDensity = MinDensity[0];
+	ChunkMaxDensity = MaxDensity[0];
+	for (int i = 1; i < MinDensity.Num(); i++)
+	{
+		ChunkMinDensity = FMath::Min(ChunkMinDensity, MinDensity[i]);
+		ChunkMaxDensity = FMath::Max(ChunkMaxDensity, MaxDensity[i]);
+	}
+}
+
+void FVoxelSummary::Fill(const float Density)
+{
+	for (int i = 0; i < MinDensity.Num(); i++)
+	{
+		MinDensity[i] = Density;
+		MaxDensity[i] = Density;
+	}
+	ChunkMinDensity = Density;
+	ChunkMaxDensity = Density;
+}
+
+int FVoxelSummary::GetBlocks() const
+{
+	return Blocks;
+}
+
+float FVoxelSummary::GetMinDensity(const int X, const int Y, const int Z) const
+{
+	return MinDensity[GetBlockIndex(X, Y, Z)];
+}
+
+float FVoxelSummary::GetMaxDensity(const int X, const int Y, const int Z) const
+{
+	return MaxDensity[GetBlockIndex(X, Y, Z)];
+}
+
+bool FVoxelSummary::IsBlockMixed(const int X, const int Y, const int Z, const float IsoLevel) const
+{
+	const int Index = GetBlockIndex(X, Y, Z);
+	return MinDensity[Index] < IsoLevel && MaxDensity[Index] >= IsoLevel;
+}
+
+bool FVoxelSummary::HasSurface(const float IsoLevel) const
+{
+	return Blocks > 0 && ChunkMinDensity < IsoLevel && ChunkMaxDensity >= IsoLevel;
+}
+
+void FVoxelSummary::UpdateBlock(const FVoxelBuffer& Voxels, const int X, const int Y, const int Z)
+{
+	const int X1 = FMath::Min((X + 1) * BlockSize, Size - 1);
+	const int Y1 = FMath::Min((Y + 1) * BlockSize, Size - 1);
+	const int Z1 = FMath::Min((Z + 1) * BlockSize, Size - 1);
+
+	int16 Min = MAX_int16;
+	int16 Max = MIN_int16;
+	Voxels.VisitLayout([&](const auto Layout)
+	{
+		for (int z = Z * BlockSize; z <= Z1; z++)
+		{
+			for (int y = Y * BlockSize; y <= Y1; y++)
+			{
+				for (int x = X * BlockSize; x <= X1; x++)
+				{
+					const int16 Density = Voxels.Densities[Layout.GetIndex(x, y, z, Size)];
+					Min = FMath::Min(Min, Density);
+					Max = FMath::Max(Max, Density);
+				}
+			}
+		}
+	});
+
+	const int Index = GetBlockIndex(X, Y, Z);
+	MinDensity[Index] = Min * FVoxelBuffer::DensityStep;
+	MaxDensity[Index] = Max * FVoxelBuffer::DensityStep;
+}
+
+int FVoxelSummary::GetBlockIndex(const int X, const int Y, const int Z) const
+{
+	return X + Blocks * (Y + Blocks * Z);
+}
@@ -0,0 +1,263 @@
+﻿#include "SurfaceNets/SurfaceNetsMeshBuilder.h"
+
+#include "MarchingCubes/MarchingCubes.h"
+#include "MarchingCubes/VoxelMaterial.h"
+
+namespace
+{
+	// Cell corners are numbered by their offsets, bit 0 = X, bit 1 = Y, bit 2 = Z
+	constexpr int CellEdges[12][2] = {
+		{0, 1}, {2, 3}, {4, 5}, {6, 7},
+		{0, 2}, {1, 3}, {4, 6}, {5, 7},
+		{0, 4}, {1, 5}, {2, 6}, {3, 7}
+	};
+}
+
+FSurfaceNetsMeshBuilder::FSurfaceNetsMeshBuilder(const bool bInDualContouring)
+	: bDualContouring(bInDualContouring)
+{
+}
+
+void FSurfaceNetsMeshBuilder::Build(const FVoxelMeshInput& Input, FVoxelMeshOutput& Output)
+{
+	Output.Reset();
+	Cells = Input.Size - 1;
+	if (Cells <= 0 || !Input.Voxels) return;
+	if (Input.Summary && !Input.Summary->HasSurface(FMarchingCubes::IsoLevel)) return;
+	const TVoxelMesherWorkspace<FWorkspace> Borrowed;
+	FWorkspace& Workspace = *Borrowed;
+	if (!GatherSamples(Workspace, Input)) return;
+
+	// Quads are split along their shorter diagonal, so the vertices are kept here until the cells are done
+	FMCMesh& Mesh = Workspace.Mesh;
+	Mesh.Reset();
+
+	// Cells [0, Cells] on every axis, the last layer reaches into the neighbours
+	const int CellsPerAxis = Cells + 1;
+	const TArray<float>& Densities = Workspace.Densities;
+	TArray<int32>& CellVertices = Workspace.CellVertices;
+	CellVertices.Init(INDEX_NONE, CellsPerAxis * CellsPerAxis * CellsPerAxis);
+	const int CornerOffsets[8] = {
+		0, 1, Samples, Samples + 1,
+		Samples * Samples, Samples * Samples + 1, Samples * Samples + Samples, Samples * Samples + Samples + 1
+	};
+	const int CellStrides[3] = {1, CellsPerAxis, CellsPerAxis * CellsPerAxis};
+
+	float W[8];
+	for (int z = 0; z < CellsPerAxis; z++)
+	{
+		for (int y = 0; y < CellsPerAxis; y++)
+		{
+			for (int x = 0; x < CellsPerAxis; x++)
+			{
+				const int Index = GetIndex(x, y, z);
+				int Inside = 0;
+				for (int i = 0; i < 8; i++)
+				{
+					W[i] = Densities[Index + CornerOffsets[i]];
+					Inside |= (W[i] < FMarchingCubes::IsoLevel) << i;
+				}
+				if (Inside == 0 || Inside == 0xFF || !IsCellAvailable(x, y, z, Input)) continue;
+
+				const int Cell = GetCellIndex(x, y, z);
+				CellVertices[Cell] = AddCellVertex(Workspace, x, y, z, W);
+
+				// A crossed edge at the low corner is bridged by the four cells around it, this one being the last
+				// visited. The chunk owns the edges that start inside it and do not lie on its low faces.
+				const int Cube[3] = {x, y, z};
+				for (int Axis = 0; Axis < 3; Axis++)
+				{
+					const int AxisU = (Axis + 1) % 3;
+					const int AxisV = (Axis + 2) % 3;
+					const bool bLowerInside = Inside & 1;
+					if (bLowerInside == ((Inside >> (1 << Axis) & 1) != 0)) continue;
+					if (Cube[Axis] == Cells || Cube[AxisU] == 0 || Cube[AxisV] == 0) continue;
+
+					const int32 C00 = CellVertices[Cell - CellStrides[AxisU] - CellStrides[AxisV]];
+					const int32 C10 = CellVertices[Cell - CellStrides[AxisV]];
+					const int32 C01 = CellVertices[Cell - CellStrides[AxisU]];
+					if (C00 == INDEX_NONE || C10 == INDEX_NONE || C01 == INDEX_NONE) continue;
+
+					// Same winding as the marching cubes triangles, facing away from the air side
+					AddQuad(Mesh, C00, C10, CellVertices[Cell], C01, bLowerInside);
+				}
+			}
+		}
+	}
+	Output.Reserve(Mesh.Vertices.Num(), Mesh.Triangles.Num());
+	TArray<int32>& OutputIds = Workspace.OutputIds;
+	Output.AppendVertices(Mesh, OutputIds);
+	for (int& Index : Mesh.Triangles)
+	{
+		Index = OutputIds[Index];
+	}
+	Output.AppendTriangles(Mesh.Triangles, OutputIds);
+}
+
+bool FSurfaceNetsMeshBuilder::GatherSamples(FWorkspace& Workspace, const FVoxelMeshInput& Input)
+{
+	const int Size = Input.Size;
+	Samples = Size + 1;
+	TArray<float>& Densities = Workspace.Densities;
+	TArray<int>& Ids = Workspace.Ids;
+	Densities.SetNumUninitialized(Samples * Samples * Samples);
+	Ids.SetNumUninitialized(Samples * Samples * Samples);
+
+	bool bAnyInside = false;
+	bool bAnyOutside = false;
+	for (int z = 0; z < Samples; z++)
+	{
+		for (int y = 0; y < Samples; y++)
+		{
+			for (int x = 0; x < Samples; x++)
+			{
+				// Past a high face the samples continue one voxel into the neighbour, its first voxel is shared with us
+				const int Mask = (x == Size) | (y == Size) << 1 | (z == Size) << 2;
+				const int Index = GetIndex(x, y, z);
+				if (!Mask)
+				{
+					const int SourceIndex = Input.Voxels->GetIndex(x, y, z);
+					Densities[Index] = Input.Voxels->GetDensity(SourceIndex);
+					Ids[Index] = Input.Voxels->Materials[SourceIndex];
+				}
+				else if (const FVoxelNeighbour& Source = Input.Neighbours[Mask])
+				{
+					// On the plane one voxel past the lowest face crossed
+					const FVoxel Voxel = Source.GetVoxel(x == Size ? 1 : x, y == Size ? 1 : y, z == Size ? 1 : z, FMath::CountTrailingZeros(Mask));
+					Densities[Index] = Voxel.Density;
+					Ids[Index] = Voxel.Id;
+				}
+				else
+				{
+					// Never read, cells touching a missing neighbour are skipped
+					Densities[Index] = FMarchingCubes::IsoLevel;
+					Ids[Index] = 0;
+					continue;
+				}
+				if (Densities[Index] < FMarchingCubes::IsoLevel) bAnyInside = true;
+				else bAnyOutside = true;
+			}
+		}
+	}
+	return bAnyInside && bAnyOutside;
+}
+
+bool FSurfaceNetsMeshBuilder::IsCellAvailable(const int X, const int Y, const int Z, const FVoxelMeshInput& Input) const
+{
+	// The cells in the last layer need every neighbour they reach into
+	const int Mask = (X == Cells) | (Y == Cells) << 1 | (Z == Cells) << 2;
+	for (int Sub = Mask; Sub > 0; Sub = (Sub - 1) & Mask)
+	{
+		if (!Input.Neighbours[Sub]) return false;
+	}
+	return true;
+}
+
+int FSurfaceNetsMeshBuilder::AddCellVertex(FWorkspace& Workspace, const int X, const int Y, const int Z, const float* W) const
+{
+	FVector Points[12];
+	FVector Normals[12];
+	int Count = 0;
+	FVector MassPoint = FVector::ZeroVector;
+	for (int e = 0; e < 12; e++)
+	{
+		const int A = CellEdges[e][0];
+		const int B = CellEdges[e][1];
+		if ((W[A] < FMarchingCubes::IsoLevel) == (W[B] < FMarchingCubes::IsoLevel)) continue;
+
+		const float T = (FMarchingCubes::IsoLevel - W[A]) / (W[B] - W[A]);
+		const FVector PA(A & 1, A >> 1 & 1, A >> 2);
+		const FVector PB(B & 1, B >> 1 & 1, B >> 2);
+		Points[Count] = PA + (PB - PA) * T;
+		MassPoint += Points[Count];
+		Count++;
+	}
+	MassPoint /= Count;
+
+	FVector Local = MassPoint;
+	if (bDualContouring)
+	{
+		for (int i = 0; i < Count; i++) Normals[i] = GetGradient(W, Points[i]).GetSafeNormal();
+		Local = SolveQef(Points, Normals, Count, MassPoint);
+		Local = FVector(FMath::Clamp(Local.X, 0.0, 1.0), FMath::Clamp(Local.Y, 0.0, 1.0), FMath::Clamp(Local.Z, 0.0, 1.0));
+	}
+
+	// Material of the nearest corner
+	const int Corner = (Local.X >= 0.5) | (Local.Y >= 0.5) << 1 | (Local.Z >= 0.5) << 2;
+	FMCMesh& Mesh = Workspace.Mesh;
+	Mesh.Colors.Add(UVoxelMaterial::Encode(Workspace.Ids[GetIndex(X + (Corner & 1), Y + (Corner >> 1 & 1), Z + (Corner >> 2))]));
+	Mesh.Normals.Add(FVector3f(GetGradient(W, Local).GetSafeNormal()));
+	return Mesh.Vertices.Add(FVector(X + Local.X, Y + Local.Y, Z + Local.Z) * VoxelSize);
+}
+
+void FSurfaceNetsMeshBuilder::AddQuad(FMCMesh& Mesh, const int32 A, const int32 B, const int32 C, const int32 D, const bool bFlip)
+{
+	// Split along the shorter diagonal
+	if (FVector::DistSquared(Mesh.Vertices[A], Mesh.Vertices[C]) <= FVector::DistSquared(Mesh.Vertices[B], Mesh.Vertices[D]))
+	{
+		if (bFlip) Mesh.Triangles.Append({A, C, B, A, D, C});
+		else Mesh.Triangles.Append({A, B, C, A, C, D});
+	}
+	else
+	{
+		if (bFlip) Mesh.Triangles.Append({A, D, B, B, D, C});
+		else Mesh.Triangles.Append({A, B, D, B, C, D});
+	}
+}
+
+FVector FSurfaceNetsMeshBuilder::GetGradient(const float* W, const FVector& P)
+{
+	// Derivative of the trilinear interpolation of the cell corners
+	const double X = P.X, Y = P.Y, Z = P.Z;
+	const double DX = (1 - Y) * (1 - Z) * (W[1] - W[0]) + Y * (1 - Z) * (W[3] - W[2]) + (1 - Y) * Z * (W[5] - W[4]) + Y * Z * (W[7] - W[6]);
+	const double DY = (1 - X) * (1 - Z) * (W[2] - W[0]) + X * (1 - Z) * (W[3] - W[1]) + (1 - X) * Z * (W[6] - W[4]) + X * Z * (W[7] - W[5]);
+	const double DZ = (1 - X) * (1 - Y) * (W[4] - W[0]) + X * (1 - Y) * (W[5] - W[1]) + (1 - X) * Y * (W[6] - W[2]) + X * Y * (W[7] - W[3]);
+	return FVector(DX, DY, DZ);
+}
+
+FVector FSurfaceNetsMeshBuilder::SolveQef(const FVector* Points, const FVector* Normals, const int Count, const FVector& MassPoint)
+{
+	// Minimizes the squared distances to the tangent planes plus a small pull towards the mass point,
+	// solved relative to the mass point with Cramer's rule on the normal equations
+	double A[3][3] = {{Regularization, 0, 0}, {0, Regularization, 0}, {0, 0, Regularization}};
+	double B[3] = {0, 0, 0};
+	for (int i = 0; i < Count; i++)
+	{
+		const FVector& N = Normals[i];
+		const double D = FVector::DotProduct(N, Points[i] - MassPoint);
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++) A[r][c] += N[r] * N[c];
+			B[r] += N[r] * D;
+		}
+	}
+
+	auto Det = [](const double M[3][3])
+	{
+		return M[0][0] * (M[1][1] * M[2][2] - M[1][2] * M[2][1])
+			- M[0][1] * (M[1][0] * M[2][2] - M[1][2] * M[2][0])
+			+ M[0][2] * (M[1][0] * M[2][1] - M[1][1] * M[2][0]);
+	};
+	const double Denominator = Det(A);
+	if (FMath::Abs(Denominator) < UE_DOUBLE_SMALL_NUMBER) return MassPoint;
+
+	FVector Offset;
+	for (int c = 0; c < 3; c++)
+	{
+		double M[3][3];
+		FMemory::Memcpy(M, A, sizeof(M));
+		for (int r = 0; r < 3; r++) M[r][c] = B[r];
+		Offset[c] = Det(M) / Denominator;
+	}
+	return MassPoint + Offset;
+}
+
+int FSurfaceNetsMeshBuilder::GetIndex(const int X, const int Y, const int Z) const
+{
+	return X + Samples * (Y + Samples * Z);
+}
+
+int FSurfaceNetsMeshBuilder::GetCellIndex(const int X, const int Y, const int Z) const
+{
+	return X + (Cells + 1) * (Y + (Cells + 1) * Z);
+}
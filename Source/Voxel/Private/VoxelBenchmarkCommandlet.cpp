@@ -0,0 +1,402 @@
+﻿#include "VoxelBenchmarkCommandlet.h"
+
+#include "VoxelGenerator.h"
+#include "VoxelMesher.h"
+#include "VoxelMeshOutput.h"
+#include "MarchingCubes/VoxelSummary.h"
+#include "VoxelBrush/SphereShape.h"
+#include "VoxelBrush/VoxelBrush.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include <atomic>
+
+namespace
+{
+	// Counts the allocations and the heap growth of everything that runs while it is installed as GMalloc. That is the
+	// whole process, not only the thread being measured, so the numbers are only clean while nothing else is running.
+	// Only memory allocated while it is installed counts, freeing what was allocated before does not lower the peak.
+	// Lives on after it is swapped out again, other threads may still be inside it at that point.
+	class FCountingMalloc : public FMalloc
+	{
+		// Allocations it counted, by address. Fixed size, it can't allocate while it is the allocator. Once it is
+		// full the rest are still counted, but never freed, so the peak can only come out too high.
+		static constexpr int TableSize = 1 << 16;
+		struct FEntry
+		{
+			void* Ptr = nullptr;
+			SIZE_T Size = 0;
+		};
+
+		FMalloc* Inner;
+		std::atomic<int64> Allocations = 0;
+		std::atomic<int64> LiveBytes = 0;
+		std::atomic<int64> PeakBytes = 0;
+		FCriticalSection TableLock;
+		FEntry Table[TableSize];
+		// Entries that hold an allocation or once did
+		int UsedEntries = 0;
+
+		static void* Removed() { return reinterpret_cast<void*>(1); }
+		static int GetSlot(const void* Ptr)
+		{
+			return static_cast<int>((reinterpret_cast<UPTRINT>(Ptr) >> 4) * 0x9E3779B97F4A7C15ull >> 48) & (TableSize - 1);
+		}
+
+		void Grow(void* Ptr)
+		{
+			SIZE_T Size = 0;
+			if (!Ptr || !Inner->GetAllocationSize(Ptr, Size)) return;
+			{
+				FScopeLock Lock(&TableLock);
+				if (UsedEntries < TableSize * 3 / 4)
+				{
+					int Slot = GetSlot(Ptr);
+					while (Table[Slot].Ptr && Table[Slot].Ptr != Removed()) Slot = (Slot + 1) & (TableSize - 1);
+					if (!Table[Slot].Ptr) UsedEntries++;
+					Table[Slot] = {Ptr, Size};
+				}
+			}
+			const int64 Live = LiveBytes += Size;
+			int64 Peak = PeakBytes;
+			while (Live > Peak && !PeakBytes.compare_exchange_weak(Peak, Live)) {}
+		}
+		void Shrink(void* Ptr)
+		{
+			if (!Ptr) return;
+			FScopeLock Lock(&TableLock);
+			for (int Slot = GetSlot(Ptr); Table[Slot].Ptr; Slot = (Slot + 1) & (TableSize - 1))
+			{
+				if (Table[Slot].Ptr != Ptr) continue;
+				LiveBytes -= Table[Slot].Size;
+				Table[Slot].Ptr = Removed();
+				return;
+			}
+		}
+	public:
+		explicit FCountingMalloc(FMalloc* InInner) : Inner(InInner) {}
+		void Reset()
+		{
+			Allocations = 0;
+			LiveBytes = 0;
+			PeakBytes = 0;
+			FScopeLock Lock(&TableLock);
+			for (FEntry& Entry : Table) Entry = FEntry();
+			UsedEntries = 0;
+		}
+		int64 GetAllocations() const { return Allocations; }
+		int64 GetPeakBytes() const { return PeakBytes; }
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			void* Ptr = Inner->Malloc(Count, Alignment);
+			++Allocations;
+			Grow(Ptr);
+			return Ptr;
+		}
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			Shrink(Original);
+			void* Ptr = Inner->Realloc(Original, Count, Alignment);
+			++Allocations;
+			Grow(Ptr);
+			return Ptr;
+		}
+		virtual void Free(void* Original) override
+		{
+			Shrink(Original);
+			Inner->Free(Original);
+		}
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual const TCHAR* GetDescriptiveName() override { return TEXT("VoxelBenchmark"); }
+	};
+}
+
+UVoxelBenchmarkCommandlet::UVoxelBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+	ShowErrorCount = true;
+	HelpDescription = TEXT("Times voxel generation, meshing and sculpting and writes the results as CSV and JSON");
+	HelpUsage = TEXT("-run=VoxelBenchmark -nullrhi [-sizes=17,33,65] [-iterations=20] [-layout=Bricks] [-csv=Path] [-json=Path] [-baseline=Path.csv] [-tolerance=0.1]");
+}
+
+int32 UVoxelBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString SizesParam = TEXT("17,33,65");
+	FParse::Value(*Params, TEXT("sizes="), SizesParam);
+	int Iterations = 20;
+	FParse::Value(*Params, TEXT("iterations="), Iterations);
+	Iterations = FMath::Max(1, Iterations);
+	FString LayoutParam;
+	FParse::Value(*Params, TEXT("layout="), LayoutParam);
+	const EVoxelLayout Layout = LayoutParam == TEXT("Bricks") ? EVoxelLayout::Bricks : EVoxelLayout::Linear;
+	FString CsvPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks/VoxelBenchmark.csv");
+	FParse::Value(*Params, TEXT("csv="), CsvPath);
+	FString JsonPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks/VoxelBenchmark.json");
+	FParse::Value(*Params, TEXT("json="), JsonPath);
+	FString BaselinePath;
+	FParse::Value(*Params, TEXT("baseline="), BaselinePath);
+	float Tolerance = 0.1f;
+	FParse::Value(*Params, TEXT("tolerance="), Tolerance);
+
+	TArray<FString> SizeStrings;
+	SizesParam.ParseIntoArray(SizeStrings, TEXT(","));
+
+	const EField Fields[] = {EField::Plane, EField::Noise, EField::Sphere, EField::Checkerboard};
+	const EVoxelMesherType Meshers[] = {EVoxelMesherType::MarchingCubes, EVoxelMesherType::SurfaceNets, EVoxelMesherType::DualContouring};
+
+	USphereShape* Shape = NewObject<USphereShape>();
+	Shape->Radius = 4;
+	UVoxelBrush* Brush = NewObject<UVoxelBrush>();
+	Brush->Shape = Shape;
+
+	TArray<FResult> Results;
+	FVoxelBuffer Data;
+	for (const FString& SizeString : SizeStrings)
+	{
+		const int Size = FCString::Atoi(*SizeString);
+		if (Size < 2) continue;
+
+		// Generation only depends on the size, the noise field is what it produces. A generator keeps the heightmaps of the
+		// columns it generated, so a new one per iteration times the noise and a reused one times the cache hits.
+		FResult GenerateCold;
+		GenerateCold.Case = TEXT("GenerateCold");
+		GenerateCold.Field = GetFieldName(EField::Noise);
+		GenerateCold.Size = Size;
+		FResult GenerateCached = GenerateCold;
+		GenerateCached.Case = TEXT("GenerateCached");
+		Data.Init(Size, Layout);
+		for (int i = 0; i < Iterations; i++)
+		{
+			const FVoxelGenerator ColdGenerator;
+			Measure(GenerateCold, [&ColdGenerator, &Data, Size]
+			{
+				ColdGenerator.Generate(FVector::ZeroVector, Size, Data);
+				return 0;
+			});
+		}
+		const FVoxelGenerator CachedGenerator;
+		CachedGenerator.Generate(FVector::ZeroVector, Size, Data);
+		for (int i = 0; i < Iterations; i++)
+		{
+			Measure(GenerateCached, [&CachedGenerator, &Data, Size]
+			{
+				CachedGenerator.Generate(FVector::ZeroVector, Size, Data);
+				return 0;
+			});
+		}
+		Results.Add(GenerateCold);
+		Results.Add(GenerateCached);
+
+		for (const EField Field : Fields)
+		{
+			FillField(Field, Size, Layout, Data);
+			FVoxelSummary Summary;
+			Summary.Init(Size);
+			Summary.Update(Data);
+
+			FVoxelMeshInput Input;
+			Input.Voxels = &Data;
+			Input.Size = Size;
+			Input.Summary = &Summary;
+
+			for (const EVoxelMesherType Type : Meshers)
+			{
+				FResult Build;
+				Build.Case = FString::Printf(TEXT("Build%s"), *StaticEnum<EVoxelMesherType>()->GetNameStringByValue(static_cast<int64>(Type)));
+				Build.Field = GetFieldName(Field);
+				Build.Size = Size;
+
+				// The first build only warms up the pooled workspaces
+				TUniquePtr<FVoxelMesher> Mesher = FVoxelMesher::Create(Type);
+				Mesher->Build(Input);
+				for (int i = 0; i < Iterations; i++)
+				{
+					Measure(Build, [&Mesher, &Input]
+					{
+						return Mesher->Build(Input).Triangles.Num() / 3;
+					});
+				}
+				Results.Add(Build);
+			}
+
+			// Sculpting goes through the same path as a chunk: edit the voxels, then remesh what changed into the dynamic mesh
+			FResult Sculpt;
+			Sculpt.Case = TEXT("Sculpt");
+			Sculpt.Field = GetFieldName(Field);
+			Sculpt.Size = Size;
+			FResult Remesh;
+			Remesh.Case = TEXT("Remesh");
+			Remesh.Field = GetFieldName(Field);
+			Remesh.Size = Size;
+
+			UE::Geometry::FDynamicMesh3 Mesh;
+			FDynamicMeshOutput Output(Mesh);
+			TUniquePtr<FVoxelMesher> Mesher = FVoxelMesher::Create(EVoxelMesherType::MarchingCubes);
+			Mesher->Build(Input, Output);
+			for (int i = 0; i < Iterations; i++)
+			{
+				// Adds and carves in turns so the field stays about the same from one iteration to the next
+				Brush->Location = FVector((Size - 1) * 0.5f);
+				Brush->Strength = i % 2 == 0 ? 1.0f : -1.0f;
+				FIntVector ChangedMin, ChangedMax;
+				bool bChanged = false;
+				Measure(Sculpt, [&]
+				{
+					bChanged = FVoxelGenerator::Sculpt(Data, Size, Brush, Summary, ChangedMin, ChangedMax);
+					return 0;
+				});
+				Input.bIncremental = bChanged;
+				Input.DirtyMin = ChangedMin;
+				Input.DirtyMax = ChangedMax;
+				Measure(Remesh, [&]
+				{
+					Mesher->Build(Input, Output);
+					return Mesh.TriangleCount();
+				});
+				Input.bIncremental = false;
+			}
+			Results.Add(Sculpt);
+			Results.Add(Remesh);
+		}
+	}
+
+	for (const FResult& Result : Results)
+	{
+		UE_LOG(LogTemp, Display, TEXT("%-24s %-12s %3d  %9.3f ms  %12.0f tris/s  %8lld allocs  %10lld peak bytes"),
+			*Result.Case, *Result.Field, Result.Size, Result.GetMsPerChunk(), Result.GetTrianglesPerSecond(),
+			Result.Allocations / FMath::Max(1, Result.Iterations), Result.PeakBytes);
+	}
+
+	if (!FFileHelper::SaveStringToFile(ToCsv(Results), *CsvPath)) UE_LOG(LogTemp, Error, TEXT("VoxelBenchmark: could not write %s"), *CsvPath);
+	if (!FFileHelper::SaveStringToFile(ToJson(Results), *JsonPath)) UE_LOG(LogTemp, Error, TEXT("VoxelBenchmark: could not write %s"), *JsonPath);
+
+	return BaselinePath.IsEmpty() ? 0 : CompareWithBaseline(Results, BaselinePath, Tolerance);
+}
+
+const TCHAR* UVoxelBenchmarkCommandlet::GetFieldName(const EField Field)
+{
+	switch (Field)
+	{
+	case EField::Plane: return TEXT("Plane");
+	case EField::Noise: return TEXT("Noise");
+	case EField::Sphere: return TEXT("Sphere");
+	case EField::Checkerboard: return TEXT("Checkerboard");
+	default: return TEXT("");
+	}
+}
+
+void UVoxelBenchmarkCommandlet::FillField(const EField Field, const int Size, const EVoxelLayout Layout, FVoxelBuffer& OutData)
+{
+	OutData.Init(Size, Layout);
+	if (Field == EField::Noise)
+	{
+		FVoxelGenerator::GetDefault()->Generate(FVector::ZeroVector, Size, OutData);
+		return;
+	}
+
+	const FVector Center((Size - 1) * 0.5f + 0.25f);
+	for (int z = 0; z < Size; z++)
+	{
+		for (int y = 0; y < Size; y++)
+		{
+			for (int x = 0; x < Size; x++)
+			{
+				float Density = 0;
+				switch (Field)
+				{
+				case EField::Plane:
+					Density = z - Center.Z;
+					break;
+				case EField::Sphere:
+					Density = FVector::Dist(FVector(x, y, z), Center) - (Size - 1) * 0.35f;
+					break;
+				case EField::Checkerboard:
+				default:
+					Density = (x + y + z) % 2 == 0 ? -1.0f : 1.0f;
+					break;
+				}
+				OutData.SetVoxel(OutData.GetIndex(x, y, z), FVoxel(Density, (x / 8 + y / 8 + z / 8) % 4));
+			}
+		}
+	}
+}
+
+void UVoxelBenchmarkCommandlet::Measure(FResult& Result, const TFunctionRef<int()> Run)
+{
+	static FCountingMalloc Counter(GMalloc);
+	Counter.Reset();
+	FMalloc* Previous = GMalloc;
+	GMalloc = &Counter;
+	const double StartTime = FPlatformTime::Seconds();
+	const int Triangles = Run();
+	const double Ms = (FPlatformTime::Seconds() - StartTime) * 1000;
+	GMalloc = Previous;
+
+	Result.Iterations++;
+	Result.TotalMs += Ms;
+	Result.MinMs = FMath::Min(Result.MinMs, Ms);
+	Result.Triangles += Triangles;
+	Result.Allocations += Counter.GetAllocations();
+	Result.PeakBytes = FMath::Max(Result.PeakBytes, Counter.GetPeakBytes());
+}
+
+FString UVoxelBenchmarkCommandlet::ToCsv(const TArray<FResult>& Results)
+{
+	FString Csv = TEXT("Case,Field,Size,Iterations,MsPerChunk,MinMs,TrianglesPerSecond,AllocationsPerChunk,PeakBytes\n");
+	for (const FResult& Result : Results)
+	{
+		Csv += FString::Printf(TEXT("%s,%d,%.4f,%.4f,%.0f,%lld,%lld\n"), *Result.GetKey(), Result.Iterations, Result.GetMsPerChunk(),
+			Result.MinMs, Result.GetTrianglesPerSecond(), Result.Allocations / FMath::Max(1, Result.Iterations), Result.PeakBytes);
+	}
+	return Csv;
+}
+
+FString UVoxelBenchmarkCommandlet::ToJson(const TArray<FResult>& Results)
+{
+	FString Json = TEXT("[\n");
+	for (int i = 0; i < Results.Num(); i++)
+	{
+		const FResult& Result = Results[i];
+		Json += FString::Printf(TEXT("\t{\"case\": \"%s\", \"field\": \"%s\", \"size\": %d, \"iterations\": %d, \"msPerChunk\": %.4f, \"minMs\": %.4f, ")
+			TEXT("\"trianglesPerSecond\": %.0f, \"allocationsPerChunk\": %lld, \"peakBytes\": %lld}%s\n"),
+			*Result.Case, *Result.Field, Result.Size, Result.Iterations, Result.GetMsPerChunk(), Result.MinMs, Result.GetTrianglesPerSecond(),
+			Result.Allocations / FMath::Max(1, Result.Iterations), Result.PeakBytes, i + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+	}
+	return Json + TEXT("]\n");
+}
+
+int UVoxelBenchmarkCommandlet::CompareWithBaseline(const TArray<FResult>& Results, const FString& BaselinePath, const double Tolerance)
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *BaselinePath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("VoxelBenchmark: could not read baseline %s"), *BaselinePath);
+		return 1;
+	}
+
+	// Matched on case, field and size, the columns are the ones ToCsv writes
+	TMap<FString, double> Baseline;
+	for (int i = 1; i < Lines.Num(); i++)
+	{
+		TArray<FString> Columns;
+		if (Lines[i].ParseIntoArray(Columns, TEXT(","), false) < 5) continue;
+		Baseline.Add(FString::Printf(TEXT("%s,%s,%s"), *Columns[0], *Columns[1], *Columns[2]), FCString::Atod(*Columns[4]));
+	}
+
+	int Regressions = 0;
+	for (const FResult& Result : Results)
+	{
+		const double* BaselineMs = Baseline.Find(Result.GetKey());
+		if (!BaselineMs || Result.GetMsPerChunk() <= *BaselineMs * (1 + Tolerance)) continue;
+		UE_LOG(LogTemp, Error, TEXT("VoxelBenchmark: %s went from %.4f ms to %.4f ms per chunk"), *Result.GetKey(), *BaselineMs, Result.GetMsPerChunk());
+		Regressions++;
+	}
+	return Regressions > 0 ? 1 : 0;
+}
@@ -5,3 +5,8 @@ float USphereShape::SignedDistance(FVector& VoxelPosition, FVector& BrushPositio
 	const float Dist = FVector::Distance(VoxelPosition, BrushPosition);
 	return Dist - Radius;
 }
+
+FBox USphereShape::GetBounds(FVector& BrushPosition)
+{
+	return FBox(BrushPosition - FVector(Radius), BrushPosition + FVector(Radius));
+}
@@ -24,3 +24,17 @@ void UVoxelBrush::Sculpt(FVoxel& Voxel, FVector& VoxelPosition)
 	Voxel.Density = Strength > 0 ?	FMath::Min(Voxel.Density, Shape->SignedDistance(VoxelPosition, Location) * Strength) :
 									FMath::Max(Voxel.Density, Shape->SignedDistance(VoxelPosition, Location) * Strength);
 }
+
+bool UVoxelBrush::CanPaint(const FBox& Region)
+{
+	return Region.Intersect(Shape->GetBounds(Location));
+}
+
+bool UVoxelBrush::CanSculpt(const FBox& Region, const float MinDensity, const float MaxDensity)
+{
+	// Outside its bounds a shape is at least as far away as the bounds are, so that distance is the lowest
+	// signed distance the region can see. The brush only changes voxels whose density is beyond it.
+	const float Gap = FMath::Sqrt(Region.ComputeSquaredDistanceToBox(Shape->GetBounds(Location)));
+	if (Gap <= 0.0f) return true;
+	return Strength > 0 ? Gap * Strength < MaxDensity : Gap * Strength > MinDensity;
+}
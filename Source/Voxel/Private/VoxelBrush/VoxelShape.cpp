@@ -4,3 +4,8 @@ float UVoxelShape::SignedDistance(FVector& VoxelPosition, FVector& BrushPosition
 {
 	return 0;
 }
+
+FBox UVoxelShape::GetBounds(FVector& BrushPosition)
+{
+	return FBox(FVector(-UE_BIG_NUMBER), FVector(UE_BIG_NUMBER));
+}
@@ -1,10 +1,12 @@
 #include "VoxelChunk.h"
 
 #include "VoxelGenerator.h"
-#include "MarchingCubes/MeshBuilder.h"
-#include "MarchingCubes/MeshData.h"
+#include "VoxelWorld.h"
+#include "MarchingCubes/MarchingCubes.h"
+#include "MarchingCubes/MeshDecimator.h"
+#include "MarchingCubes/VoxelBufferPool.h"
 #include "VoxelStats.h"
-#include "DynamicMesh/MeshAttributeUtil.h"
+#include "Async/Async.h"
 
 UVoxelChunk::UVoxelChunk()
 {
@@ -24,9 +26,11 @@ void UVoxelChunk::BeginPlay()
 	MeshComponent->SetGenerateOverlapEvents(true);
 	MeshComponent->SetCollisionResponseToChannel(ECC_Visibility, ECR_Block);
 		
-	Data = new FVoxel[Size * Size * Size];
-
-	FVoxelGenerator::Clear(Data, Size);
+	// Empty like FVoxelGenerator::Clear leaves it, without filling a buffer for it
+	Summary.Init(Size);
+	SetUniform(FVoxel(1.0f, 0));
+	LastVoxelAccess = FPlatformTime::Seconds();
+	bFullUpdate = true;
 	// Generate();
 	// Update();
 }
@@ -34,20 +38,30 @@ void UVoxelChunk::BeginPlay()
 void UVoxelChunk::BeginDestroy()
 {
 	Super::BeginDestroy();
-	delete Data;
-	Data = nullptr;
+	Voxels.Reset();
+	CompressedVoxels.Empty();
 }
 
 void UVoxelChunk::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (World && World->CompressIdleSeconds > 0 && !bUniform && !IsCompressed() && FPlatformTime::Seconds() - LastVoxelAccess > World->CompressIdleSeconds)
+	{
+		Compress();
+	}
 }
 
 void UVoxelChunk::SetSize(int NewSize)
 {
 	Size = NewSize;
-	delete Data;
-	Data = new FVoxel[Size * Size * Size];
+	VoxelSerial++;
+	Summary.Init(Size);
+	SetUniform(FVoxel(1.0f, 0));
+	LastVoxelAccess = FPlatformTime::Seconds();
+	bFullUpdate = true;
+	// Recorded edits don't fit the new voxels
+	if (World) World->ClearUndoHistory();
 }
 
 void UVoxelChunk::Sculpt(UVoxelBrush* VoxelBrush)
@@ -64,61 +78,368 @@ void UVoxelChunk::Sculpt(UVoxelBrush* VoxelBrush)
 	LocalSpaceBrush->Strength = VoxelBrush->Strength;
 	LocalSpaceBrush->Location = BrushLocalLocation;
 
-	FVoxelGenerator::Sculpt(Data, Size, LocalSpaceBrush);
+	const bool bWasUniform = bUniform;
+	if (bUniform && !LocalSpaceBrush->CanSculpt(FBox(FVector::ZeroVector, FVector(Size - 1)), UniformVoxel.Density, UniformVoxel.Density)) return;
+
+	// Only the voxels the brush can reach are kept for the journal, the edit itself stays in place
+	FVoxelEditJournal* Journal = World ? World->GetJournal() : nullptr;
+	FVoxelChunkDelta Delta;
+	if (Journal)
+	{
+		FIntVector RegionMin, RegionMax;
+		if (!FVoxelGenerator::GetSculptRegion(Size, LocalSpaceBrush, Summary, RegionMin, RegionMax)) return;
+		Delta.Capture(ReadVoxels(), RegionMin, RegionMax);
+	}
+
+	FIntVector ChangedMin, ChangedMax;
+	if (FVoxelGenerator::Sculpt(GetVoxels(), Size, LocalSpaceBrush, Summary, ChangedMin, ChangedMax))
+	{
+		MarkDirty(ChangedMin, ChangedMax);
+		if (Journal)
+		{
+			Delta.Record(*Voxels, ChangedMin, ChangedMax);
+			Journal->Record(ChunkID, MoveTemp(Delta));
+		}
+	}
+	else if (bWasUniform) SetUniform(UniformVoxel);
 }
 
 void UVoxelChunk::Paint(UVoxelBrush* VoxelBrush, int MaterialId)
 {
-	FVoxelGenerator::Paint(Data, Size, VoxelBrush, MaterialId);
+	if (bUniform && (UniformVoxel.Id == MaterialId || !VoxelBrush->CanPaint(FBox(FVector::ZeroVector, FVector(Size - 1))))) return;
+
+	const bool bWasUniform = bUniform;
+	FVoxelEditJournal* Journal = World ? World->GetJournal() : nullptr;
+	FVoxelChunkDelta Delta;
+	if (Journal)
+	{
+		FIntVector RegionMin, RegionMax;
+		if (!FVoxelGenerator::GetPaintRegion(Size, VoxelBrush, Summary, RegionMin, RegionMax)) return;
+		Delta.Capture(ReadVoxels(), RegionMin, RegionMax);
+	}
+
+	FIntVector ChangedMin, ChangedMax;
+	if (FVoxelGenerator::Paint(GetVoxels(), Size, VoxelBrush, MaterialId, Summary, ChangedMin, ChangedMax))
+	{
+		MarkDirty(ChangedMin, ChangedMax);
+		if (Journal)
+		{
+			Delta.Record(*Voxels, ChangedMin, ChangedMax);
+			Journal->Record(ChunkID, MoveTemp(Delta));
+		}
+	}
+	else if (bWasUniform) SetUniform(UniformVoxel);
 }
 
-void UVoxelChunk::Generate() const
+void UVoxelChunk::ForgetHistory() const
 {
-	const double StartTime = FPlatformTime::Seconds();
-	FVoxelGenerator::Generate(GetOwner()->GetActorLocation(), Size, Data);
-	StatsRef.GenerateTime = (FPlatformTime::Seconds() - StartTime) * 1000;
+	FVoxelEditJournal* Journal = World ? World->GetJournal() : nullptr;
+	if (Journal) Journal->ForgetChunk(ChunkID);
+}
+
+bool UVoxelChunk::ApplyDelta(const FVoxelChunkDelta& Delta)
+{
+	FVoxelBuffer& Data = GetVoxels();
+	if (!Delta.Apply(Data)) return false;
+	Summary.Update(Data, Delta.Min, Delta.Max);
+	MarkDirty(Delta.Min, Delta.Max);
+	return true;
 }
 
-void UVoxelChunk::Update() const
+void UVoxelChunk::Generate()
 {
 	const double StartTime = FPlatformTime::Seconds();
-	FMCMeshBuilder MeshBuilder;
-	const FMCMesh MeshData = MeshBuilder.Build(Data, Size);
-	StatsRef.VertexCount = MeshData.Vertices.Num();
-	StatsRef.TriangleCount = MeshData.Triangles.Num();
+	// Overwrites every voxel, whatever the chunk held before doesn't need unpacking. Dropped first, so the buffer comes
+	// straight back out of the pool unless a snapshot still holds it.
+	Voxels.Reset();
+	const TSharedRef<FVoxelBuffer, ESPMode::ThreadSafe> NewVoxels = FVoxelBufferPool::Get().AllocateShared(Size, Layout);
+	GenerateVoxels(*NewVoxels);
+	FVoxelSummary NewSummary;
+	NewSummary.Init(Size);
+	NewSummary.Update(*NewVoxels);
+	SetGeneratedVoxels(NewVoxels, MoveTemp(NewSummary), (FPlatformTime::Seconds() - StartTime) * 1000);
+}
+
+void UVoxelChunk::GenerateVoxels(FVoxelBuffer& Data)
+{
+	const TSharedRef<const FVoxelGenerator, ESPMode::ThreadSafe> Generator = World ? World->GetGenerator() : FVoxelGenerator::GetDefault();
+	Generator->Generate(GetOwner()->GetActorLocation(), Size, Data);
+}
 
-	TArray<int32> Indices;
+void UVoxelChunk::SetGeneratedVoxels(const TSharedRef<FVoxelBuffer, ESPMode::ThreadSafe>& NewVoxels, FVoxelSummary&& NewSummary, const double GenerateTime)
+{
+	bUniform = false;
+	CompressedVoxels.Empty();
+	Voxels = NewVoxels;
+	Summary = MoveTemp(NewSummary);
+	VoxelSerial++;
+	LastVoxelAccess = FPlatformTime::Seconds();
+	TryCollapse();
+	UpdateVoxelBytes();
+	bFullUpdate = true;
+	StatsRef.GenerateTime = GenerateTime;
+	ForgetHistory();
+}
+
+void UVoxelChunk::Update()
+{
+	const double StartTime = FPlatformTime::Seconds();
 	FDynamicMesh3* Mesh = MeshComponent->GetMesh();
-	Mesh->Clear();
-	Mesh->EnableVertexNormals(FVector3f());  
-	Mesh->EnableVertexColors(FVector4f());
+	const bool bDecimate = World && World->DecimationLod > 0 && Lod >= World->DecimationLod;
+	const bool bIncremental = bDirtyRegion && !bFullUpdate && !bDecimate;
+	bDirtyRegion = false;
+	// The mesher's parts no longer describe the mesh once a decimated one is swapped in
+	bFullUpdate = bDecimate;
+	const int Serial = ++MeshSerial;
 
-	Mesh->EnableAttributes();
-	Mesh->Attributes()->EnablePrimaryColors();
-	const auto ColorOverlay = Mesh->Attributes()->PrimaryColors();
+	// All air or all solid and nothing left over from before, there is nothing to build or upload
+	if (!HasSurface() && Mesh->TriangleCount() == 0)
+	{
+		StatsRef.VertexCount = 0;
+		StatsRef.TriangleCount = 0;
+		StatsRef.UpdateTime = (FPlatformTime::Seconds() - StartTime) * 1000;
+		return;
+	}
 
-	const FVector ChunkWorldOrigin = GetOwner()->GetActorLocation();
+	if (!Mesher || MesherBuiltFor != MesherType)
+	{
+		Mesher = FVoxelMesher::Create(MesherType);
+		MesherBuiltFor = MesherType;
+	}
 
-	for (int i = 0; i < MeshData.Vertices.Num(); i++)
+	FVoxelMeshInput Input;
+	Input.Voxels = &ReadVoxels();
+	Input.Size = Size;
+	Input.Summary = &Summary;
+	Input.Lod = Lod;
+	Input.TransitionFaces = TransitionFaces;
+	// Neighbours are read as they are now, so only a chunk that was just sculpted or painted can be spliced
+	Input.bIncremental = bIncremental;
+	Input.DirtyMin = DirtyMin;
+	Input.DirtyMax = DirtyMax;
+	if (World)
 	{
-		int Id = Mesh->AppendVertex(MeshData.Vertices[i]);
-		Indices.Add(Id);
-		Mesh->SetVertexNormal(Id, FVector3f(MeshData.Normals[i]));
-		Mesh->SetVertexColor(Id, FVector4f(MeshData.Colors[i]));
-		ColorOverlay->AppendElement(MeshData.Colors[i]);
+		for (int i = 1; i < 8; i++)
+		{
+			UVoxelChunk* Neighbour = World->FindChunk(ChunkID + FIntVector(i & 1, i >> 1 & 1, i >> 2));
+			if (Neighbour && Neighbour->Size == Size) Input.Neighbours[i] = Neighbour->ReadBorder();
+		}
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			FIntVector Offset = FIntVector::ZeroValue;
+			Offset[Axis] = 1;
+			UVoxelChunk* Neighbour = World->FindChunk(ChunkID - Offset);
+			if (Neighbour && Neighbour->Size == Size) Input.LowNeighbours[Axis] = Neighbour->ReadBorder();
+		}
 	}
 
-	for (int i = 0; i < MeshData.Triangles.Num(); i += 3)
+	// Distant chunks are meshed here and decimated on a worker, they keep showing their last mesh until it is done
+	if (bDecimate)
 	{
-		const int T0 = Indices[MeshData.Triangles[i]];
-		const int T1 = Indices[MeshData.Triangles[i + 1]];
-		const int T2 = Indices[MeshData.Triangles[i + 2]];
-		const int Id = Mesh->AppendTriangle(T0, T1, T2);
-		ColorOverlay->SetTriangle(Id, UE::Geometry::FIndex3i(T0, T1, T2));
+		FMCMesh Full = Mesher->Build(Input);
+		const int TargetTriangleCount = FMath::CeilToInt(Full.Triangles.Num() / 3 * World->DecimationRatio);
+		const FBox Bounds(FVector::ZeroVector, FVector((Size - 1) * FVoxelMesher::VoxelSize));
+		TWeakObjectPtr<UVoxelChunk> WeakThis(this);
+		Async(EAsyncExecution::ThreadPool, [WeakThis, Serial, TargetTriangleCount, Bounds, Full = MoveTemp(Full)]() mutable
+		{
+			FMeshDecimator(Full, Bounds).Decimate(TargetTriangleCount);
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, Serial, Decimated = MoveTemp(Full)]
+			{
+				UVoxelChunk* Chunk = WeakThis.Get();
+				if (Chunk && Chunk->MeshSerial == Serial) Chunk->ApplyDecimatedMesh(Decimated);
+			});
+		});
+		StatsRef.UpdateTime = (FPlatformTime::Seconds() - StartTime) * 1000;
+		return;
 	}
 
+	// Written straight into the component's mesh, incremental builds only replace the parts the dirty voxels touch
+	FDynamicMeshOutput Output(*Mesh);
+	Mesher->Build(Input, Output);
+	StatsRef.VertexCount = Mesh->VertexCount();
+	StatsRef.TriangleCount = Mesh->TriangleCount();
+
 	MeshComponent->NotifyMeshUpdated();
 	MeshComponent->UpdateCollision(false);
 
 	StatsRef.UpdateTime = (FPlatformTime::Seconds() - StartTime) * 1000;
 }
+
+void UVoxelChunk::ApplyDecimatedMesh(const FMCMesh& Decimated)
+{
+	FDynamicMeshOutput Output(*MeshComponent->GetMesh());
+	Output.Reset();
+	Output.Reserve(Decimated.Vertices.Num(), Decimated.Triangles.Num());
+	TArray<int32> VertexIds;
+	Output.AppendVertices(Decimated, VertexIds);
+	TArray<int> Indices;
+	Indices.Reserve(Decimated.Triangles.Num());
+	for (const int Index : Decimated.Triangles) Indices.Add(VertexIds[Index]);
+	TArray<int32> TriangleIds;
+	Output.AppendTriangles(Indices, TriangleIds);
+	StatsRef.VertexCount = Decimated.Vertices.Num();
+	StatsRef.TriangleCount = TriangleIds.Num();
+
+	MeshComponent->NotifyMeshUpdated();
+	MeshComponent->UpdateCollision(false);
+}
+
+bool UVoxelChunk::HasSurface() const
+{
+	return Summary.HasSurface(FMarchingCubes::IsoLevel);
+}
+
+FVoxel UVoxelChunk::GetVoxel(const FIntVector Position)
+{
+	if (Position.GetMin() < 0 || Position.GetMax() >= Size) return FVoxel(1.0f, 0);
+	const FVoxelBuffer& Buffer = ReadVoxels();
+	return Buffer.GetVoxel(Buffer.GetIndex(Position.X, Position.Y, Position.Z));
+}
+
+void UVoxelChunk::Unpack()
+{
+	if (bUniform)
+	{
+		bUniform = false;
+		Voxels = FVoxelBufferPool::Get().AllocateShared(Size, Layout);
+		Voxels->Fill(UniformVoxel);
+		UpdateVoxelBytes();
+	}
+	else if (IsCompressed())
+	{
+		// Unpacked into a pooled buffer, Decompress keeps it when the length already fits
+		Voxels = FVoxelBufferPool::Get().AllocateShared(Size, Layout);
+		if (!CompressedVoxels.Decompress(*Voxels))
+		{
+			// Nothing to recover from, start over from the generator
+			UE_LOG(LogTemp, Error, TEXT("VoxelChunk %s: compressed voxels are corrupt, regenerating"), *ChunkID.ToString());
+			FVoxelBufferPool::Get().Allocate(*Voxels, Size, Layout);
+			GenerateVoxels(*Voxels);
+			Summary.Update(*Voxels);
+			bFullUpdate = true;
+			ForgetHistory();
+		}
+		CompressedVoxels.Empty();
+		UpdateVoxelBytes();
+	}
+}
+
+FVoxelBuffer& UVoxelChunk::GetVoxels()
+{
+	LastVoxelAccess = FPlatformTime::Seconds();
+	VoxelSerial++;
+	Unpack();
+	if (!Voxels.IsUnique())
+	{
+		// A snapshot keeps the old voxels, the edit goes to a copy of them
+		const TSharedRef<FVoxelBuffer, ESPMode::ThreadSafe> Copy = FVoxelBufferPool::Get().AllocateShared(Size, Voxels->Layout);
+		Copy->CopyVoxels(*Voxels);
+		Voxels = Copy;
+	}
+	return *Voxels;
+}
+
+const FVoxelBuffer& UVoxelChunk::ReadVoxels()
+{
+	LastVoxelAccess = FPlatformTime::Seconds();
+	if (bUniform) return *GetUniformBuffer(Size, UniformVoxel);
+	Unpack();
+	return *Voxels;
+}
+
+FVoxelNeighbour UVoxelChunk::ReadBorder() const
+{
+	FVoxelNeighbour Border;
+	if (bUniform) Border.Voxels = &*GetUniformBuffer(Size, UniformVoxel);
+	else if (IsCompressed()) Border.Packed = &CompressedVoxels;
+	else Border.Voxels = Voxels.Get();
+	return Border;
+}
+
+FVoxelSnapshot UVoxelChunk::Snapshot()
+{
+	LastVoxelAccess = FPlatformTime::Seconds();
+	if (bUniform) return GetUniformBuffer(Size, UniformVoxel);
+	Unpack();
+	return Voxels.ToSharedRef();
+}
+
+FVoxelSnapshot UVoxelChunk::GetUniformBuffer(const int ChunkSize, const FVoxel& Voxel)
+{
+	// Only read and filled on the game thread. Few values ever come up, air, solid and the clamped densities far
+	// above and below the terrain, so the buffers are kept for good. Linear whatever the chunk uses, readers go
+	// through GetIndex.
+	static TMap<FIntVector, TSharedPtr<const FVoxelBuffer, ESPMode::ThreadSafe>> Buffers;
+	const FIntVector Key(ChunkSize, FVoxelBuffer::QuantizeDensity(Voxel.Density), Voxel.Id);
+	TSharedPtr<const FVoxelBuffer, ESPMode::ThreadSafe>& Buffer = Buffers.FindOrAdd(Key);
+	if (!Buffer)
+	{
+		const TSharedRef<FVoxelBuffer, ESPMode::ThreadSafe> Filled = MakeShared<FVoxelBuffer, ESPMode::ThreadSafe>();
+		Filled->Init(ChunkSize);
+		Filled->Fill(Voxel);
+		Buffer = Filled;
+	}
+	return Buffer.ToSharedRef();
+}
+
+void UVoxelChunk::SetUniform(const FVoxel& Voxel)
+{
+	// Stored as the dense buffer would hold it, so expanding it again gives back the same voxels
+	UniformVoxel = FVoxel(FVoxelBuffer::QuantizeDensity(Voxel.Density) * FVoxelBuffer::DensityStep, static_cast<uint8>(Voxel.Id));
+	bUniform = true;
+	Voxels.Reset();
+	CompressedVoxels.Empty();
+	Summary.Fill(UniformVoxel.Density);
+	UpdateVoxelBytes();
+}
+
+bool UVoxelChunk::TryCollapse()
+{
+	if (bUniform || !Voxels || !Voxels->IsUniform()) return bUniform;
+	SetUniform(Voxels->GetVoxel(0));
+	return true;
+}
+
+void UVoxelChunk::Compress()
+{
+	if (bUniform || IsCompressed() || !Voxels || TryCollapse()) return;
+	CompressedVoxels.Compress(*Voxels);
+	Voxels.Reset();
+	UpdateVoxelBytes();
+}
+
+void UVoxelChunk::UpdateVoxelBytes()
+{
+	StatsRef.VoxelBytes = static_cast<int>((Voxels ? Voxels->GetAllocatedSize() : 0) + CompressedVoxels.GetAllocatedSize());
+}
+
+bool UVoxelChunk::SetLod(const int NewLod, const ETransitionFace NewTransitionFaces)
+{
+	if (Lod == NewLod && TransitionFaces == NewTransitionFaces) return false;
+	Lod = NewLod;
+	TransitionFaces = NewTransitionFaces;
+	bFullUpdate = true;
+	return true;
+}
+
+void UVoxelChunk::MarkDirty(const FIntVector& Min, const FIntVector& Max)
+{
+	if (bDirtyRegion)
+	{
+		DirtyMin = FIntVector(FMath::Min(DirtyMin.X, Min.X), FMath::Min(DirtyMin.Y, Min.Y), FMath::Min(DirtyMin.Z, Min.Z));
+		DirtyMax = FIntVector(FMath::Max(DirtyMax.X, Max.X), FMath::Max(DirtyMax.Y, Max.Y), FMath::Max(DirtyMax.Z, Max.Z));
+	}
+	else
+	{
+		DirtyMin = Min;
+		DirtyMax = Max;
+		bDirtyRegion = true;
+	}
+}
+
+bool UVoxelChunk::GetDirtyRegion(FIntVector& OutMin, FIntVector& OutMax) const
+{
+	OutMin = DirtyMin;
+	OutMax = DirtyMax;
+	return bDirtyRegion;
+}
@@ -0,0 +1,210 @@
+﻿#include "VoxelEditJournal.h"
+#include "Misc/Compression.h"
+
+void FVoxelChunkDelta::Capture(const FVoxelBuffer& Before, const FIntVector& InMin, const FIntVector& InMax)
+{
+	Min = InMin;
+	Max = InMax;
+	const FIntVector Extent = Max - Min + FIntVector(1);
+	const int NumVoxels = Extent.X * Extent.Y * Extent.Z;
+	RawSize = NumVoxels * (sizeof(int16) + sizeof(uint8));
+	bCompressed = false;
+
+	Data.SetNumUninitialized(RawSize);
+	int16* Densities = reinterpret_cast<int16*>(Data.GetData());
+	uint8* Materials = Data.GetData() + NumVoxels * sizeof(int16);
+	for (int z = Min.Z, i = 0; z <= Max.Z; z++)
+	{
+		for (int y = Min.Y; y <= Max.Y; y++)
+		{
+			for (int x = Min.X; x <= Max.X; x++, i++)
+			{
+				const int Index = Before.GetIndex(x, y, z);
+				Densities[i] = Before.Densities[Index];
+				Materials[i] = Before.Materials[Index];
+			}
+		}
+	}
+}
+
+void FVoxelChunkDelta::Record(const FVoxelBuffer& After, const FIntVector& InMin, const FIntVector& InMax)
+{
+	check(!bCompressed && InMin.X >= Min.X && InMin.Y >= Min.Y && InMin.Z >= Min.Z && InMax.X <= Max.X && InMax.Y <= Max.Y && InMax.Z <= Max.Z);
+	const FIntVector CapturedExtent = Max - Min + FIntVector(1);
+	const int16* BeforeDensities = reinterpret_cast<const int16*>(Data.GetData());
+	const uint8* BeforeMaterials = Data.GetData() + CapturedExtent.X * CapturedExtent.Y * CapturedExtent.Z * sizeof(int16);
+
+	const FIntVector Extent = InMax - InMin + FIntVector(1);
+	const int NumVoxels = Extent.X * Extent.Y * Extent.Z;
+	RawSize = NumVoxels * (sizeof(int16) + sizeof(uint8));
+
+	TArray<uint8> Raw;
+	Raw.SetNumUninitialized(RawSize);
+	uint16* Densities = reinterpret_cast<uint16*>(Raw.GetData());
+	uint8* Materials = Raw.GetData() + NumVoxels * sizeof(int16);
+	for (int z = InMin.Z, i = 0; z <= InMax.Z; z++)
+	{
+		for (int y = InMin.Y; y <= InMax.Y; y++)
+		{
+			int BeforeIndex = ((z - Min.Z) * CapturedExtent.Y + y - Min.Y) * CapturedExtent.X + InMin.X - Min.X;
+			for (int x = InMin.X; x <= InMax.X; x++, i++, BeforeIndex++)
+			{
+				const int AfterIndex = After.GetIndex(x, y, z);
+				Densities[i] = static_cast<uint16>(BeforeDensities[BeforeIndex]) ^ static_cast<uint16>(After.Densities[AfterIndex]);
+				Materials[i] = BeforeMaterials[BeforeIndex] ^ After.Materials[AfterIndex];
+			}
+		}
+	}
+	Min = InMin;
+	Max = InMax;
+
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_LZ4, RawSize);
+	Data.SetNumUninitialized(CompressedSize);
+	bCompressed = FCompression::CompressMemory(NAME_LZ4, Data.GetData(), CompressedSize, Raw.GetData(), RawSize) && CompressedSize < RawSize;
+	if (bCompressed)
+	{
+		Data.SetNum(CompressedSize);
+		Data.Shrink();
+	}
+	else
+	{
+		Data = MoveTemp(Raw);
+	}
+}
+
+bool FVoxelChunkDelta::Apply(FVoxelBuffer& Voxels) const
+{
+	if (Min.GetMin() < 0 || Max.GetMax() >= Voxels.Size) return false;
+
+	TArray<uint8> Unpacked;
+	const uint8* Raw = Data.GetData();
+	if (bCompressed)
+	{
+		Unpacked.SetNumUninitialized(RawSize);
+		if (!FCompression::UncompressMemory(NAME_LZ4, Unpacked.GetData(), RawSize, Data.GetData(), Data.Num())) return false;
+		Raw = Unpacked.GetData();
+	}
+
+	const FIntVector Extent = Max - Min + FIntVector(1);
+	const int NumVoxels = Extent.X * Extent.Y * Extent.Z;
+	const uint16* Densities = reinterpret_cast<const uint16*>(Raw);
+	const uint8* Materials = Raw + NumVoxels * sizeof(int16);
+	for (int z = Min.Z, i = 0; z <= Max.Z; z++)
+	{
+		for (int y = Min.Y; y <= Max.Y; y++)
+		{
+			for (int x = Min.X; x <= Max.X; x++, i++)
+			{
+				const int Index = Voxels.GetIndex(x, y, z);
+				Voxels.Densities[Index] = static_cast<int16>(static_cast<uint16>(Voxels.Densities[Index]) ^ Densities[i]);
+				Voxels.Materials[Index] ^= Materials[i];
+			}
+		}
+	}
+	return true;
+}
+
+void FVoxelEditJournal::SetMaxBytes(const int64 InMaxBytes)
+{
+	MaxBytes = InMaxBytes;
+	Trim();
+}
+
+void FVoxelEditJournal::BeginEdit()
+{
+	bEditOpen = true;
+}
+
+void FVoxelEditJournal::EndEdit()
+{
+	bEditOpen = false;
+	if (OpenEdit.Deltas.Num() > 0) Commit(MoveTemp(OpenEdit));
+	OpenEdit = FEdit();
+}
+
+void FVoxelEditJournal::Record(const FIntVector& ChunkID, FVoxelChunkDelta&& Delta)
+{
+	FEdit Single;
+	FEdit& Edit = bEditOpen ? OpenEdit : Single;
+	Delta.ChunkID = ChunkID;
+	Edit.Bytes += Delta.GetAllocatedSize();
+	Edit.Deltas.Add(MoveTemp(Delta));
+	if (!bEditOpen) Commit(MoveTemp(Single));
+}
+
+void FVoxelEditJournal::ForgetChunk(const FIntVector& ChunkID)
+{
+	// The open edit is not counted in Bytes until it is committed
+	Forget(OpenEdit, ChunkID);
+	for (int i = Edits.Num() - 1; i >= 0; i--)
+	{
+		Bytes -= Forget(Edits[i], ChunkID);
+		if (Edits[i].Deltas.Num() > 0) continue;
+		Edits.RemoveAt(i);
+		if (i < Current) Current--;
+	}
+}
+
+int64 FVoxelEditJournal::Forget(FEdit& Edit, const FIntVector& ChunkID)
+{
+	int64 Forgotten = 0;
+	for (int i = Edit.Deltas.Num() - 1; i >= 0; i--)
+	{
+		if (Edit.Deltas[i].ChunkID != ChunkID) continue;
+		Forgotten += Edit.Deltas[i].GetAllocatedSize();
+		Edit.Deltas.RemoveAt(i);
+	}
+	Edit.Bytes -= Forgotten;
+	return Forgotten;
+}
+
+void FVoxelEditJournal::Commit(FEdit&& Edit)
+{
+	// A new edit branches off the history, whatever was undone before it can't be redone any more
+	for (int i = Current; i < Edits.Num(); i++) Bytes -= Edits[i].Bytes;
+	Edits.SetNum(Current);
+	Bytes += Edit.Bytes;
+	Edits.Add(MoveTemp(Edit));
+	Current = Edits.Num();
+	Trim();
+}
+
+void FVoxelEditJournal::Trim()
+{
+	// Edits that were undone go first, dropping the oldest of them would leave the later ones nothing to redo onto
+	while (Bytes > MaxBytes && Edits.Num() > Current)
+	{
+		Bytes -= Edits.Last().Bytes;
+		Edits.Pop();
+	}
+	int Dropped = 0;
+	while (Dropped < Current && Bytes > MaxBytes)
+	{
+		Bytes -= Edits[Dropped].Bytes;
+		Dropped++;
+	}
+	if (Dropped == 0) return;
+	Edits.RemoveAt(0, Dropped);
+	Current -= Dropped;
+}
+
+const TArray<FVoxelChunkDelta>* FVoxelEditJournal::Undo()
+{
+	if (!CanUndo()) return nullptr;
+	return &Edits[--Current].Deltas;
+}
+
+const TArray<FVoxelChunkDelta>* FVoxelEditJournal::Redo()
+{
+	if (!CanRedo()) return nullptr;
+	return &Edits[Current++].Deltas;
+}
+
+void FVoxelEditJournal::Empty()
+{
+	Edits.Empty();
+	Current = 0;
+	Bytes = 0;
+	bEditOpen = false;
+	OpenEdit = FEdit();
+}
@@ -1,70 +1,270 @@
 ﻿#include "VoxelGenerator.h"
+#include "VoxelGeneratorGraph.h"
+#include "Async/ParallelFor.h"
 
-FastNoiseLite FVoxelGenerator::Noise = FastNoiseLite();
+FVoxelGenerator::FVoxelGenerator(const int32 InSeed, const TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe>& InGraph)
+	: Seed(InSeed)
+	, Graph(InGraph)
+	, Noise(InSeed)
+{
+}
 
-void FVoxelGenerator::Sculpt(FVoxel* Data, const int Size, UVoxelBrush* VoxelBrush)
+TSharedRef<const FVoxelGenerator, ESPMode::ThreadSafe> FVoxelGenerator::GetDefault()
 {
-	for(int x = 0; x < Size; x++)
+	static const TSharedRef<const FVoxelGenerator, ESPMode::ThreadSafe> Default = MakeShared<FVoxelGenerator, ESPMode::ThreadSafe>();
+	return Default;
+}
+
+bool FVoxelGenerator::Sculpt(FVoxelBuffer& Data, const int Size, UVoxelBrush* VoxelBrush, FVoxelSummary& Summary, FIntVector& OutChangedMin, FIntVector& OutChangedMax)
+{
+	const int Blocks = Summary.GetBlocks();
+	OutChangedMin = FIntVector(Size);
+	OutChangedMax = FIntVector(-1);
+
+	for(int bz = 0; bz < Blocks; bz++)
 	{
-		for(int y = 0; y < Size; y++)
+		for(int by = 0; by < Blocks; by++)
 		{
-			for(int z = 0; z < Size; z++)
+			for(int bx = 0; bx < Blocks; bx++)
 			{
-				const int Index = x + Size * (y + Size * z);
-				FVector Position = FVector(x, y, z);
-				// FVector Location = VoxelWorldLocation / 100.f + Position;
-				VoxelBrush->Sculpt(Data[Index], Position);
+				FIntVector Begin, End;
+				GetBlockRange(bx, Blocks, Size, Begin.X, End.X);
+				GetBlockRange(by, Blocks, Size, Begin.Y, End.Y);
+				GetBlockRange(bz, Blocks, Size, Begin.Z, End.Z);
+				const FBox Region(FVector(Begin), FVector(End - FIntVector(1)));
+				if(!VoxelBrush->CanSculpt(Region, Summary.GetMinDensity(bx, by, bz), Summary.GetMaxDensity(bx, by, bz))) continue;
+
+				for(int z = Begin.Z; z < End.Z; z++)
+				{
+					for(int y = Begin.Y; y < End.Y; y++)
+					{
+						for(int x = Begin.X; x < End.X; x++)
+						{
+							const int Index = Data.GetIndex(x, y, z);
+							const int16 Density = Data.Densities[Index];
+							FVoxel Voxel = Data.GetVoxel(Index);
+							FVector Position = FVector(x, y, z);
+							// FVector Location = VoxelWorldLocation / 100.f + Position;
+							VoxelBrush->Sculpt(Voxel, Position);
+							// Changes too small to survive quantization leave the voxel as it was
+							Data.SetVoxel(Index, Voxel);
+							if(Data.Densities[Index] != Density) GrowRegion(x, y, z, OutChangedMin, OutChangedMax);
+						}
+					}
+				}
 			}
 		}
 	}
+
+	if(OutChangedMax.X < 0) return false;
+	Summary.Update(Data, OutChangedMin, OutChangedMax);
+	return true;
 }
 
-void FVoxelGenerator::Paint(FVoxel* Data, const int Size, UVoxelBrush* VoxelBrush, const int MaterialId)
+bool FVoxelGenerator::Paint(FVoxelBuffer& Data, const int Size, UVoxelBrush* VoxelBrush, const int MaterialId, const FVoxelSummary& Summary, FIntVector& OutChangedMin, FIntVector& OutChangedMax)
 {
-	for(int x = 0; x < Size; x++)
+	const int Blocks = Summary.GetBlocks();
+	OutChangedMin = FIntVector(Size);
+	OutChangedMax = FIntVector(-1);
+	for(int bz = 0; bz < Blocks; bz++)
 	{
-		for(int y = 0; y < Size; y++)
+		for(int by = 0; by < Blocks; by++)
 		{
-			for(int z = 0; z < Size; z++)
+			for(int bx = 0; bx < Blocks; bx++)
 			{
-				const int Index = x + Size * (y + Size * z);
-				FVector Position = FVector(x, y, z);
-				VoxelBrush->Paint(Data[Index], Position, MaterialId);
+				FIntVector Begin, End;
+				GetBlockRange(bx, Blocks, Size, Begin.X, End.X);
+				GetBlockRange(by, Blocks, Size, Begin.Y, End.Y);
+				GetBlockRange(bz, Blocks, Size, Begin.Z, End.Z);
+				if(!VoxelBrush->CanPaint(FBox(FVector(Begin), FVector(End - FIntVector(1))))) continue;
+
+				for(int z = Begin.Z; z < End.Z; z++)
+				{
+					for(int y = Begin.Y; y < End.Y; y++)
+					{
+						for(int x = Begin.X; x < End.X; x++)
+						{
+							const int Index = Data.GetIndex(x, y, z);
+							const uint8 Id = Data.Materials[Index];
+							FVoxel Voxel = Data.GetVoxel(Index);
+							FVector Position = FVector(x, y, z);
+							VoxelBrush->Paint(Voxel, Position, MaterialId);
+							Data.Materials[Index] = static_cast<uint8>(Voxel.Id);
+							if(Data.Materials[Index] != Id) GrowRegion(x, y, z, OutChangedMin, OutChangedMax);
+						}
+					}
+				}
 			}
 		}
 	}
+	return OutChangedMax.X >= 0;
 }
 
-void FVoxelGenerator::Generate(const FVector Origin, const int Size, FVoxel* Data)
+bool FVoxelGenerator::GetSculptRegion(const int Size, UVoxelBrush* VoxelBrush, const FVoxelSummary& Summary, FIntVector& OutMin, FIntVector& OutMax)
 {
-	for(int x = 0; x < Size; x++)
+	const int Blocks = Summary.GetBlocks();
+	OutMin = FIntVector(Size);
+	OutMax = FIntVector(-1);
+	for(int bz = 0; bz < Blocks; bz++)
 	{
-		for(int y = 0; y < Size; y++)
+		for(int by = 0; by < Blocks; by++)
 		{
-			for(int z = 0; z < Size; z++)
+			for(int bx = 0; bx < Blocks; bx++)
 			{
-				const int Index = x + Size * (y + Size * z);
-				Data[Index] = GetVoxel(Origin + FVector(x, y, z));
+				FIntVector Begin, End;
+				GetBlockRange(bx, Blocks, Size, Begin.X, End.X);
+				GetBlockRange(by, Blocks, Size, Begin.Y, End.Y);
+				GetBlockRange(bz, Blocks, Size, Begin.Z, End.Z);
+				const FBox Region(FVector(Begin), FVector(End - FIntVector(1)));
+				if(!VoxelBrush->CanSculpt(Region, Summary.GetMinDensity(bx, by, bz), Summary.GetMaxDensity(bx, by, bz))) continue;
+				GrowRegion(Begin.X, Begin.Y, Begin.Z, OutMin, OutMax);
+				GrowRegion(End.X - 1, End.Y - 1, End.Z - 1, OutMin, OutMax);
 			}
 		}
 	}
+	return OutMax.X >= 0;
 }
 
-FVoxel FVoxelGenerator::GetVoxel(const FVector Position)
+bool FVoxelGenerator::GetPaintRegion(const int Size, UVoxelBrush* VoxelBrush, const FVoxelSummary& Summary, FIntVector& OutMin, FIntVector& OutMax)
 {
-	FVoxel VoxelData;
-	const float Scale = 7;
-	const float Height = Noise.GetNoise(Position.X * Scale, Position.Y * Scale) * 4.0 + 8;
-	VoxelData.Density = Position.Z - Height;
-	if(Position.Z < -8) VoxelData.Id = 1;
-	return VoxelData;
+	const int Blocks = Summary.GetBlocks();
+	OutMin = FIntVector(Size);
+	OutMax = FIntVector(-1);
+	for(int bz = 0; bz < Blocks; bz++)
+	{
+		for(int by = 0; by < Blocks; by++)
+		{
+			for(int bx = 0; bx < Blocks; bx++)
+			{
+				FIntVector Begin, End;
+				GetBlockRange(bx, Blocks, Size, Begin.X, End.X);
+				GetBlockRange(by, Blocks, Size, Begin.Y, End.Y);
+				GetBlockRange(bz, Blocks, Size, Begin.Z, End.Z);
+				if(!VoxelBrush->CanPaint(FBox(FVector(Begin), FVector(End - FIntVector(1))))) continue;
+				GrowRegion(Begin.X, Begin.Y, Begin.Z, OutMin, OutMax);
+				GrowRegion(End.X - 1, End.Y - 1, End.Z - 1, OutMin, OutMax);
+			}
+		}
+	}
+	return OutMax.X >= 0;
+}
+
+void FVoxelGenerator::GetBlockRange(const int Block, const int Blocks, const int Size, int& OutBegin, int& OutEnd)
+{
+	// Blocks split the voxels without overlap, the last one also takes the voxels on the far side of the chunk
+	OutBegin = Block * FVoxelSummary::BlockSize;
+	OutEnd = Block == Blocks - 1 ? Size : OutBegin + FVoxelSummary::BlockSize;
+}
+
+void FVoxelGenerator::GrowRegion(const int X, const int Y, const int Z, FIntVector& Min, FIntVector& Max)
+{
+	Min.X = FMath::Min(Min.X, X);
+	Min.Y = FMath::Min(Min.Y, Y);
+	Min.Z = FMath::Min(Min.Z, Z);
+	Max.X = FMath::Max(Max.X, X);
+	Max.Y = FMath::Max(Max.Y, Y);
+	Max.Z = FMath::Max(Max.Z, Z);
 }
 
-void FVoxelGenerator::Clear(FVoxel* Data, int Size)
+void FVoxelGenerator::Generate(const FVector Origin, const int Size, FVoxelBuffer& Data) const
 {
-	for(int i = 0; i < Size * Size * Size; ++i)
+	check(Data.Size == Size);
+	if (Graph) Graph->Generate(Origin, Size, Data);
+	else GenerateHeightfield(Origin, Size, Data);
+}
+
+void FVoxelGenerator::GenerateHeightfield(const FVector Origin, const int Size, FVoxelBuffer& Data) const
+{
+	const FHeightmap Heightmap = GetHeightmap(Origin, Size);
+	const float* Heights = Heightmap->GetData();
+
+	Data.FillPlanes([Heights, Origin, Size](const int32 z, const auto& SetVoxel)
 	{
-		Data[i].Density = 1.0f; 
-		Data[i].Id = 0;
+		const double Z = Origin.Z + z;
+		const uint8 Material = static_cast<uint8>(GetMaterial(Z));
+		for(int y = 0; y < Size; y++)
+		{
+			const float* Row = Heights + y * Size;
+			for(int x = 0; x < Size; x++)
+			{
+				SetVoxel(x, y, Z - Row[x], Material);
+			}
+		}
+	});
+}
+
+FVoxelGenerator::FHeightmap FVoxelGenerator::GetHeightmap(const FVector Origin, const int Size) const
+{
+	const FVector Key(Origin.X, Origin.Y, Size);
+	{
+		FScopeLock ScopeLock(&HeightmapLock);
+		if (FCachedHeightmap* Cached = Heightmaps.Find(Key))
+		{
+			Cached->LastUse = ++HeightmapUses;
+			return Cached->Heights.ToSharedRef();
+		}
+	}
+
+	const TSharedRef<TArray<float>, ESPMode::ThreadSafe> Heights = MakeShared<TArray<float>, ESPMode::ThreadSafe>();
+	Heights->SetNumUninitialized(Size * Size);
+	// A row of noise at a time, from the same coordinates GetHeight passes
+	TArray<double, TInlineAllocator<128>> NoiseX;
+	TArray<double, TInlineAllocator<128>> NoiseY;
+	NoiseX.SetNumUninitialized(Size);
+	NoiseY.SetNumUninitialized(Size);
+	for(int x = 0; x < Size; x++)
+	{
+		NoiseX[x] = (Origin.X + x) * NoiseScale;
+	}
+	for(int y = 0; y < Size; y++)
+	{
+		for(int x = 0; x < Size; x++)
+		{
+			NoiseY[x] = (Origin.Y + y) * NoiseScale;
+		}
+		float* Row = Heights->GetData() + y * Size;
+		Noise.GetNoiseBatch(NoiseX.GetData(), NoiseY.GetData(), Row, Size);
+		for(int x = 0; x < Size; x++)
+		{
+			Row[x] = Row[x] * HeightAmplitude + BaseHeight;
+		}
 	}
+
+	FScopeLock ScopeLock(&HeightmapLock);
+	if (Heightmaps.Num() >= MaxCachedHeightmaps && !Heightmaps.Contains(Key))
+	{
+		FVector Oldest = Key;
+		uint64 OldestUse = MAX_uint64;
+		for (const TPair<FVector, FCachedHeightmap>& Pair : Heightmaps)
+		{
+			if (Pair.Value.LastUse >= OldestUse) continue;
+			Oldest = Pair.Key;
+			OldestUse = Pair.Value.LastUse;
+		}
+		Heightmaps.Remove(Oldest);
+	}
+	FCachedHeightmap& Cached = Heightmaps.FindOrAdd(Key);
+	Cached.Heights = Heights;
+	Cached.LastUse = ++HeightmapUses;
+	return Heights;
+}
+
+FVoxel FVoxelGenerator::GetVoxel(const FVector Position) const
+{
+	return FVoxel(Position.Z - GetHeight(Position.X, Position.Y), GetMaterial(Position.Z));
+}
+
+float FVoxelGenerator::GetHeight(const double X, const double Y) const
+{
+	return Noise.GetNoise(X * NoiseScale, Y * NoiseScale) * HeightAmplitude + BaseHeight;
+}
+
+int FVoxelGenerator::GetMaterial(const double Z)
+{
+	return Z < -8 ? 1 : 0;
+}
+
+void FVoxelGenerator::Clear(FVoxelBuffer& Data, int Size)
+{
+	Data.Fill(FVoxel(1.0f, 0));
 }
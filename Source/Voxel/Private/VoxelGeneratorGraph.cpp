@@ -0,0 +1,322 @@
+﻿#include "VoxelGeneratorGraph.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	int GetNumInputs(const EVoxelGraphOp Op)
+	{
+		switch (Op)
+		{
+		case EVoxelGraphOp::Constant:
+		case EVoxelGraphOp::PositionX:
+		case EVoxelGraphOp::PositionY:
+		case EVoxelGraphOp::PositionZ:
+			return 0;
+		case EVoxelGraphOp::Abs:
+		case EVoxelGraphOp::Negate:
+			return 1;
+		case EVoxelGraphOp::Noise3D:
+		case EVoxelGraphOp::Sphere:
+		case EVoxelGraphOp::Box:
+			return 3;
+		default:
+			return 2;
+		}
+	}
+
+	bool IsPositional(const EVoxelGraphOp Op)
+	{
+		return Op == EVoxelGraphOp::Noise2D || Op == EVoxelGraphOp::Noise3D || Op == EVoxelGraphOp::Sphere || Op == EVoxelGraphOp::Box;
+	}
+
+	// The loop is picked once per row, so the one that runs has nothing in it but the op
+	template <typename FOp>
+	void RunBinary(float* Out, const float* A, const float* B, const float Value, const int Count, FOp Op)
+	{
+		if (A && B) for (int x = 0; x < Count; x++) Out[x] = Op(A[x], B[x]);
+		else if (A) for (int x = 0; x < Count; x++) Out[x] = Op(A[x], Value);
+		else if (B) for (int x = 0; x < Count; x++) Out[x] = Op(Value, B[x]);
+		else for (int x = 0; x < Count; x++) Out[x] = Op(Value, Value);
+	}
+
+	template <typename FOp>
+	void RunUnary(float* Out, const float* A, const float Value, const int Count, FOp Op)
+	{
+		if (A) for (int x = 0; x < Count; x++) Out[x] = Op(A[x]);
+		else for (int x = 0; x < Count; x++) Out[x] = Op(Value);
+	}
+
+	float SmoothMin(const float A, const float B, const float Smoothness)
+	{
+		if (Smoothness <= 0) return FMath::Min(A, B);
+		const float H = FMath::Clamp(0.5f + 0.5f * (B - A) / Smoothness, 0.0f, 1.0f);
+		return FMath::Lerp(B, A, H) - Smoothness * H * (1 - H);
+	}
+}
+
+int32 FVoxelGraphProgram::AddRegister(const bool bColumn)
+{
+	FRegister& Register = Registers.AddDefaulted_GetRef();
+	Register.bColumn = bColumn;
+	Register.Slot = bColumn ? NumColumnSlots++ : NumVoxelSlots++;
+	return Registers.Num() - 1;
+}
+
+TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe> FVoxelGraphProgram::Compile(const UVoxelGeneratorGraph& Graph, const int32 Seed)
+{
+	const TArray<FVoxelGraphNode>& Nodes = Graph.Nodes;
+	const int32 DensityNode = Graph.DensityNode == INDEX_NONE ? Nodes.Num() - 1 : Graph.DensityNode;
+	if (!Nodes.IsValidIndex(DensityNode))
+	{
+		UE_LOG(LogTemp, Error, TEXT("VoxelGeneratorGraph %s: density node %d does not exist"), *Graph.GetName(), DensityNode);
+		return nullptr;
+	}
+	for (int32 i = 0; i < Nodes.Num(); i++)
+	{
+		const FVoxelGraphNode& Node = Nodes[i];
+		const int32 Inputs[3] = {Node.A, Node.B, Node.C};
+		for (int j = 0; j < GetNumInputs(Node.Op); j++)
+		{
+			if (Inputs[j] == INDEX_NONE || (Inputs[j] >= 0 && Inputs[j] < i)) continue;
+			UE_LOG(LogTemp, Error, TEXT("VoxelGeneratorGraph %s: node %d reads node %d, only earlier nodes can be read"), *Graph.GetName(), i, Inputs[j]);
+			return nullptr;
+		}
+		if ((Node.Op == EVoxelGraphOp::SmoothMin || Node.Op == EVoxelGraphOp::SmoothMax) && (Node.A == INDEX_NONE || Node.B == INDEX_NONE))
+		{
+			UE_LOG(LogTemp, Error, TEXT("VoxelGeneratorGraph %s: node %d blends less than two nodes"), *Graph.GetName(), i);
+			return nullptr;
+		}
+	}
+	for (const FVoxelMaterialRule& Rule : Graph.MaterialRules)
+	{
+		if (Nodes.IsValidIndex(Rule.Node)) continue;
+		UE_LOG(LogTemp, Error, TEXT("VoxelGeneratorGraph %s: material %d is picked by node %d, which does not exist"), *Graph.GetName(), Rule.Material, Rule.Node);
+		return nullptr;
+	}
+
+	// Only what the density and the materials read, walked back from them since every node reads earlier ones
+	TArray<bool> Used;
+	Used.Init(false, Nodes.Num());
+	Used[DensityNode] = true;
+	for (const FVoxelMaterialRule& Rule : Graph.MaterialRules) Used[Rule.Node] = true;
+	for (int32 i = Nodes.Num() - 1; i >= 0; i--)
+	{
+		if (!Used[i]) continue;
+		const FVoxelGraphNode& Node = Nodes[i];
+		const int32 Inputs[3] = {Node.A, Node.B, Node.C};
+		for (int j = 0; j < GetNumInputs(Node.Op); j++)
+		{
+			if (Inputs[j] != INDEX_NONE) Used[Inputs[j]] = true;
+		}
+	}
+
+	const TSharedRef<FVoxelGraphProgram, ESPMode::ThreadSafe> Program = MakeShared<FVoxelGraphProgram, ESPMode::ThreadSafe>();
+	Program->AddRegister(true);
+	Program->AddRegister(true);
+	Program->AddRegister(false);
+
+	TArray<int32> NodeRegisters;
+	NodeRegisters.Init(INDEX_NONE, Nodes.Num());
+	for (int32 i = 0; i < Nodes.Num(); i++)
+	{
+		if (!Used[i]) continue;
+		const FVoxelGraphNode& Node = Nodes[i];
+		if (Node.Op == EVoxelGraphOp::PositionX || Node.Op == EVoxelGraphOp::PositionY || Node.Op == EVoxelGraphOp::PositionZ)
+		{
+			NodeRegisters[i] = Node.Op == EVoxelGraphOp::PositionX ? PositionX : Node.Op == EVoxelGraphOp::PositionY ? PositionY : PositionZ;
+			continue;
+		}
+
+		FInstruction Instruction;
+		Instruction.Op = Node.Op;
+		Instruction.Value = Node.Value;
+		Instruction.Center = FVector3f(Node.Center);
+		Instruction.Extent = FVector3f(Node.Extent);
+
+		// Positional nodes default to the voxel position, the rest read Value where nothing is plugged in
+		const int32 Inputs[3] = {Node.A, Node.B, Node.C};
+		const int32 Positions[3] = {PositionX, PositionY, PositionZ};
+		bool bColumn = true;
+		for (int j = 0; j < GetNumInputs(Node.Op); j++)
+		{
+			const int32 Register = Inputs[j] != INDEX_NONE ? NodeRegisters[Inputs[j]] : IsPositional(Node.Op) ? Positions[j] : INDEX_NONE;
+			Instruction.Inputs[j] = Register;
+			if (Register != INDEX_NONE && !Program->Registers[Register].bColumn) bColumn = false;
+		}
+
+		if (Node.Op == EVoxelGraphOp::Noise2D || Node.Op == EVoxelGraphOp::Noise3D)
+		{
+			// Both enums list their values in the same order as FastNoiseLite's
+			FastNoiseLite& Noise = Instruction.Noise;
+			Noise.SetSeed(Seed + Node.Noise.Seed);
+			Noise.SetFrequency(Node.Noise.Frequency);
+			Noise.SetNoiseType(static_cast<FastNoiseLite::NoiseType>(Node.Noise.Type));
+			Noise.SetFractalType(static_cast<FastNoiseLite::FractalType>(Node.Noise.Fractal));
+			Noise.SetFractalOctaves(FMath::Max(1, Node.Noise.Octaves));
+			Noise.SetFractalLacunarity(Node.Noise.Lacunarity);
+			Noise.SetFractalGain(Node.Noise.Gain);
+		}
+
+		Instruction.Out = NodeRegisters[i] = Program->AddRegister(bColumn);
+		(bColumn ? Program->ColumnInstructions : Program->VoxelInstructions).Add(MoveTemp(Instruction));
+	}
+
+	Program->DensityRegister = NodeRegisters[DensityNode];
+	for (const FVoxelMaterialRule& Rule : Graph.MaterialRules)
+	{
+		Program->MaterialRules.Add({NodeRegisters[Rule.Node], Rule.Min, Rule.Max, Rule.Material});
+	}
+	Program->DefaultMaterial = Graph.DefaultMaterial;
+	return Program;
+}
+
+void FVoxelGraphProgram::Generate(const FVector Origin, const int Size, FVoxelBuffer& Data) const
+{
+	// Column registers over the whole XY plane, one row after the other
+	TArray<float> Columns;
+	Columns.SetNumUninitialized(NumColumnSlots * Size * Size);
+	auto SetColumnRows = [this, &Columns, Size](const int y, float** Rows)
+	{
+		for (int32 i = 0; i < Registers.Num(); i++)
+		{
+			if (Registers[i].bColumn) Rows[i] = Columns.GetData() + (Registers[i].Slot * Size + y) * Size;
+		}
+	};
+
+	ParallelFor(Size, [this, &SetColumnRows, Origin, Size](const int32 y)
+	{
+		TArray<float*, TInlineAllocator<64>> Rows;
+		Rows.Init(nullptr, Registers.Num());
+		SetColumnRows(y, Rows.GetData());
+		for (int x = 0; x < Size; x++)
+		{
+			Rows[PositionX][x] = Origin.X + x;
+			Rows[PositionY][x] = Origin.Y + y;
+		}
+		Run(ColumnInstructions, Rows.GetData(), Size);
+	});
+
+	Data.FillPlanes([this, &SetColumnRows, Origin, Size](const int32 z, const auto& SetVoxel)
+	{
+		TArray<float> Scratch;
+		Scratch.SetNumUninitialized(NumVoxelSlots * Size);
+		TArray<float*, TInlineAllocator<64>> Rows;
+		Rows.Init(nullptr, Registers.Num());
+		for (int32 i = 0; i < Registers.Num(); i++)
+		{
+			if (!Registers[i].bColumn) Rows[i] = Scratch.GetData() + Registers[i].Slot * Size;
+		}
+		for (int x = 0; x < Size; x++)
+		{
+			Rows[PositionZ][x] = Origin.Z + z;
+		}
+
+		for (int y = 0; y < Size; y++)
+		{
+			SetColumnRows(y, Rows.GetData());
+			Run(VoxelInstructions, Rows.GetData(), Size);
+
+			const float* Densities = Rows[DensityRegister];
+			for (int x = 0; x < Size; x++)
+			{
+				uint8 Material = DefaultMaterial;
+				for (const FMaterialRule& Rule : MaterialRules)
+				{
+					const float Value = Rows[Rule.Register][x];
+					if (Value < Rule.Min || Value >= Rule.Max) continue;
+					Material = Rule.Material;
+					break;
+				}
+				SetVoxel(x, y, Densities[x], Material);
+			}
+		}
+	});
+}
+
+void FVoxelGraphProgram::Run(const TArray<FInstruction>& Instructions, float* const* Rows, const int Count)
+{
+	for (const FInstruction& Instruction : Instructions)
+	{
+		float* Out = Rows[Instruction.Out];
+		const float* A = Instruction.Inputs[0] != INDEX_NONE ? Rows[Instruction.Inputs[0]] : nullptr;
+		const float* B = Instruction.Inputs[1] != INDEX_NONE ? Rows[Instruction.Inputs[1]] : nullptr;
+		const float* C = Instruction.Inputs[2] != INDEX_NONE ? Rows[Instruction.Inputs[2]] : nullptr;
+		const float Value = Instruction.Value;
+		const FVector3f& Center = Instruction.Center;
+		const FVector3f& Extent = Instruction.Extent;
+
+		switch (Instruction.Op)
+		{
+		case EVoxelGraphOp::Constant:
+			for (int x = 0; x < Count; x++) Out[x] = Value;
+			break;
+		case EVoxelGraphOp::Noise2D:
+			Instruction.Noise.GetNoiseBatch(A, B, Out, Count);
+			break;
+		case EVoxelGraphOp::Noise3D:
+			for (int x = 0; x < Count; x++) Out[x] = Instruction.Noise.GetNoise(A[x], B[x], C[x]);
+			break;
+		case EVoxelGraphOp::Sphere:
+			for (int x = 0; x < Count; x++)
+			{
+				const FVector3f P(A[x] - Center.X, B[x] - Center.Y, C[x] - Center.Z);
+				Out[x] = P.Size() - Value;
+			}
+			break;
+		case EVoxelGraphOp::Box:
+			for (int x = 0; x < Count; x++)
+			{
+				const FVector3f Q(FMath::Abs(A[x] - Center.X) - Extent.X, FMath::Abs(B[x] - Center.Y) - Extent.Y, FMath::Abs(C[x] - Center.Z) - Extent.Z);
+				const FVector3f Outside(FMath::Max(Q.X, 0.0f), FMath::Max(Q.Y, 0.0f), FMath::Max(Q.Z, 0.0f));
+				Out[x] = Outside.Size() + FMath::Min(FMath::Max3(Q.X, Q.Y, Q.Z), 0.0f);
+			}
+			break;
+		case EVoxelGraphOp::Add:
+			RunBinary(Out, A, B, Value, Count, [](const float L, const float R) { return L + R; });
+			break;
+		case EVoxelGraphOp::Subtract:
+			RunBinary(Out, A, B, Value, Count, [](const float L, const float R) { return L - R; });
+			break;
+		case EVoxelGraphOp::Multiply:
+			RunBinary(Out, A, B, Value, Count, [](const float L, const float R) { return L * R; });
+			break;
+		case EVoxelGraphOp::Min:
+			RunBinary(Out, A, B, Value, Count, [](const float L, const float R) { return FMath::Min(L, R); });
+			break;
+		case EVoxelGraphOp::Max:
+			RunBinary(Out, A, B, Value, Count, [](const float L, const float R) { return FMath::Max(L, R); });
+			break;
+		case EVoxelGraphOp::SmoothMin:
+			for (int x = 0; x < Count; x++) Out[x] = SmoothMin(A[x], B[x], Value);
+			break;
+		case EVoxelGraphOp::SmoothMax:
+			for (int x = 0; x < Count; x++) Out[x] = -SmoothMin(-A[x], -B[x], Value);
+			break;
+		case EVoxelGraphOp::Abs:
+			RunUnary(Out, A, Value, Count, [](const float V) { return FMath::Abs(V); });
+			break;
+		case EVoxelGraphOp::Negate:
+			RunUnary(Out, A, Value, Count, [](const float V) { return -V; });
+			break;
+		default:
+			// Positions are filled in before the instructions run
+			break;
+		}
+	}
+}
+
+TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe> UVoxelGeneratorGraph::GetProgram(const int32 Seed)
+{
+	// Invalid graphs are kept as null too, so the error is only logged once
+	if (const TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe>* Program = Programs.Find(Seed)) return *Program;
+	return Programs.Add(Seed, FVoxelGraphProgram::Compile(*this, Seed));
+}
+
+#if WITH_EDITOR
+void UVoxelGeneratorGraph::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	// Chunks still generating keep the program they started with
+	Programs.Empty();
+}
+#endif
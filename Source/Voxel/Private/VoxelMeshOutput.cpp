@@ -0,0 +1,137 @@
+﻿#include "VoxelMeshOutput.h"
+
+FMCMeshOutput::FMCMeshOutput(FMCMesh& InMesh)
+	: Mesh(InMesh)
+{
+}
+
+void FMCMeshOutput::Reset()
+{
+	Mesh = FMCMesh();
+}
+
+void FMCMeshOutput::Reserve(const int32 VertexCount, const int32 IndexCount)
+{
+	Mesh.Vertices.Reserve(Mesh.Vertices.Num() + VertexCount);
+	Mesh.Normals.Reserve(Mesh.Normals.Num() + VertexCount);
+	Mesh.Colors.Reserve(Mesh.Colors.Num() + VertexCount);
+	Mesh.Triangles.Reserve(Mesh.Triangles.Num() + IndexCount);
+}
+
+void FMCMeshOutput::AppendVertices(const FMCMesh& Part, TArray<int32>& OutIds)
+{
+	const int32 First = Mesh.Vertices.Num();
+	Mesh.Vertices.Append(Part.Vertices);
+	Mesh.Normals.Append(Part.Normals);
+	Mesh.Colors.Append(Part.Colors);
+
+	OutIds.SetNumUninitialized(Part.Vertices.Num());
+	for (int i = 0; i < OutIds.Num(); i++) OutIds[i] = First + i;
+}
+
+void FMCMeshOutput::AppendTriangles(const TArray<int>& Indices, TArray<int32>& OutIds)
+{
+	const int32 First = Mesh.Triangles.Num() / 3;
+	Mesh.Triangles.Append(Indices);
+
+	OutIds.SetNumUninitialized(Indices.Num() / 3);
+	for (int i = 0; i < OutIds.Num(); i++) OutIds[i] = First + i;
+}
+
+bool FMCMeshOutput::SupportsRemoval() const
+{
+	return false;
+}
+
+void FMCMeshOutput::RemoveTriangles(const TArray<int32>& Ids, const bool bKeepVertices)
+{
+	checkNoEntry();
+}
+
+FDynamicMeshOutput::FDynamicMeshOutput(UE::Geometry::FDynamicMesh3& InMesh)
+	: Mesh(InMesh)
+{
+	if (Mesh.HasAttributes()) ColorOverlay = Mesh.Attributes()->PrimaryColors();
+}
+
+void FDynamicMeshOutput::Reset()
+{
+	Mesh.Clear();
+	Mesh.EnableVertexNormals(FVector3f());
+	Mesh.EnableVertexColors(FVector3f());
+	Mesh.EnableAttributes();
+	Mesh.Attributes()->EnablePrimaryColors();
+	ColorOverlay = Mesh.Attributes()->PrimaryColors();
+}
+
+void FDynamicMeshOutput::Reserve(const int32 VertexCount, const int32 IndexCount)
+{
+	// FDynamicMesh3 grows its storage in fixed size blocks, there is nothing to reserve up front
+}
+
+void FDynamicMeshOutput::AppendVertices(const FMCMesh& Part, TArray<int32>& OutIds)
+{
+	// Ids freed by removed parts are handed out again, the color element takes the id of its vertex so triangles can share them
+	OutIds.SetNumUninitialized(Part.Vertices.Num());
+	UE::Geometry::FVertexInfo Info;
+	Info.bHaveN = true;
+	Info.bHaveC = true;
+	for (int i = 0; i < Part.Vertices.Num(); i++)
+	{
+		const FVector4f Color(Part.Colors[i]);
+		Info.Position = Part.Vertices[i];
+		Info.Normal = Part.Normals[i];
+		Info.Color = FVector3f(Color.X, Color.Y, Color.Z);
+		OutIds[i] = Mesh.AppendVertex(Info);
+		ColorOverlay->InsertElement(OutIds[i], &Color.X);
+	}
+}
+
+void FDynamicMeshOutput::AppendTriangles(const TArray<int>& Indices, TArray<int32>& OutIds)
+{
+	OutIds.Reset(Indices.Num() / 3);
+	for (int i = 0; i + 2 < Indices.Num(); i += 3)
+	{
+		const UE::Geometry::FIndex3i Triangle(Indices[i], Indices[i + 1], Indices[i + 2]);
+		const int Id = Mesh.AppendTriangle(Triangle);
+		if (Id < 0) continue;
+		ColorOverlay->SetTriangle(Id, Triangle);
+		OutIds.Add(Id);
+	}
+}
+
+bool FDynamicMeshOutput::SupportsRemoval() const
+{
+	return true;
+}
+
+void FDynamicMeshOutput::RemoveTriangles(const TArray<int32>& Ids, const bool bKeepVertices)
+{
+	if (!bKeepVertices)
+	{
+		for (const int32 Id : Ids)
+		{
+			Mesh.RemoveTriangle(Id, true, false);
+		}
+		return;
+	}
+
+	// The overlay frees elements once no triangle uses them, the kept vertices get theirs back under the same id
+	TArray<TPair<int32, FVector4f>> Elements;
+	Elements.Reserve(Ids.Num() * 3);
+	for (const int32 Id : Ids)
+	{
+		const UE::Geometry::FIndex3i Triangle = Mesh.GetTriangle(Id);
+		for (int j = 0; j < 3; j++)
+		{
+			FVector4f Color;
+			ColorOverlay->GetElement(Triangle[j], Color);
+			Elements.Emplace(Triangle[j], Color);
+		}
+		Mesh.RemoveTriangle(Id, false, false);
+	}
+	for (const TPair<int32, FVector4f>& Element : Elements)
+	{
+		if (!ColorOverlay->IsElement(Element.Key)) ColorOverlay->InsertElement(Element.Key, &Element.Value.X);
+	}
+}
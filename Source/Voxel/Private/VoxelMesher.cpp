@@ -0,0 +1,26 @@
+﻿#include "VoxelMesher.h"
+
+#include "MarchingCubes/MeshBuilder.h"
+#include "SurfaceNets/SurfaceNetsMeshBuilder.h"
+
+FMCMesh FVoxelMesher::Build(const FVoxelMeshInput& Input)
+{
+	FMCMesh Mesh;
+	FMCMeshOutput Output(Mesh);
+	Build(Input, Output);
+	return Mesh;
+}
+
+TUniquePtr<FVoxelMesher> FVoxelMesher::Create(const EVoxelMesherType Type)
+{
+	switch (Type)
+	{
+	case EVoxelMesherType::SurfaceNets:
+		return MakeUnique<FSurfaceNetsMeshBuilder>(false);
+	case EVoxelMesherType::DualContouring:
+		return MakeUnique<FSurfaceNetsMeshBuilder>(true);
+	case EVoxelMesherType::MarchingCubes:
+	default:
+		return MakeUnique<FMCMeshBuilder>();
+	}
+}
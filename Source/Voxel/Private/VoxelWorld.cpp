@@ -1,6 +1,8 @@
 ﻿#include "VoxelWorld.h"
 
+#include "VoxelGeneratorGraph.h"
 #include "VoxelBrush/SphereShape.h"
+#include "Async/Async.h"
 
 AVoxelWorld::AVoxelWorld()
 {
@@ -40,6 +42,10 @@ UVoxelChunk* AVoxelWorld::GetOrCreateChunkByID(const FIntVector& ChunkID)
 		return nullptr;
 	}
 
+	NewChunk->World = this;
+	NewChunk->ChunkID = ChunkID;
+	NewChunk->MesherType = MesherType;
+	NewChunk->Layout = VoxelLayout;
 	Chunks.Add(ChunkID, NewChunk);
 
 	UE_LOG(LogTemp, Warning, TEXT("VoxelWorld: 创建新区块, ID: %s, 位置: %s"), *ChunkID.ToString(), *NewChunkLocation.ToString());
@@ -47,6 +53,67 @@ UVoxelChunk* AVoxelWorld::GetOrCreateChunkByID(const FIntVector& ChunkID)
 	return NewChunk;
 }
 
+UVoxelChunk* AVoxelWorld::FindChunk(const FIntVector& ChunkID) const
+{
+	UVoxelChunk* const* FoundChunk = Chunks.Find(ChunkID);
+	return FoundChunk ? *FoundChunk : nullptr;
+}
+
+void AVoxelWorld::GenerateChunksAsync(const TArray<FIntVector>& ChunkIDs, FOnVoxelChunksGenerated OnGenerated)
+{
+	// Passed through the workers but only touched on the game thread
+	struct FBatch
+	{
+		TArray<TWeakObjectPtr<UVoxelChunk>> Chunks;
+		int Remaining = 0;
+		FOnVoxelChunksGenerated OnGenerated;
+	};
+	const TSharedRef<FBatch, ESPMode::ThreadSafe> Batch = MakeShared<FBatch, ESPMode::ThreadSafe>();
+	Batch->OnGenerated = OnGenerated;
+	const TSharedRef<const FVoxelGenerator, ESPMode::ThreadSafe> Generator = GetGenerator();
+
+	for (const FIntVector& ChunkID : ChunkIDs)
+	{
+		UVoxelChunk* Chunk = GetOrCreateChunkByID(ChunkID);
+		if (!Chunk || Batch->Chunks.Contains(Chunk)) continue;
+		Batch->Chunks.Add(Chunk);
+		Batch->Remaining++;
+
+		TWeakObjectPtr<UVoxelChunk> WeakChunk(Chunk);
+		const FVector Origin = Chunk->GetOwner()->GetActorLocation();
+		const int Size = Chunk->Size;
+		const EVoxelLayout Layout = Chunk->Layout;
+		const int Serial = Chunk->GetVoxelSerial();
+		Async(EAsyncExecution::TaskGraph, [Batch, WeakChunk, Origin, Size, Layout, Serial, Generator]
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			const TSharedRef<FVoxelBuffer, ESPMode::ThreadSafe> Voxels = FVoxelBufferPool::Get().AllocateShared(Size, Layout);
+			Generator->Generate(Origin, Size, *Voxels);
+			FVoxelSummary Summary;
+			Summary.Init(Size);
+			Summary.Update(*Voxels);
+			const double GenerateTime = (FPlatformTime::Seconds() - StartTime) * 1000;
+
+			AsyncTask(ENamedThreads::GameThread, [Batch, WeakChunk, Serial, Voxels, Summary = MoveTemp(Summary), GenerateTime]() mutable
+			{
+				UVoxelChunk* Chunk = WeakChunk.Get();
+				if (Chunk && Chunk->GetVoxelSerial() == Serial) Chunk->SetGeneratedVoxels(Voxels, MoveTemp(Summary), GenerateTime);
+				if (--Batch->Remaining > 0) return;
+
+				TArray<UVoxelChunk*> Chunks;
+				for (const TWeakObjectPtr<UVoxelChunk>& Generated : Batch->Chunks)
+				{
+					if (UVoxelChunk* Valid = Generated.Get()) Chunks.Add(Valid);
+				}
+				Batch->OnGenerated.ExecuteIfBound(Chunks);
+			});
+		});
+	}
+
+	// Nothing to wait for
+	if (Batch->Remaining == 0) OnGenerated.ExecuteIfBound(TArray<UVoxelChunk*>());
+}
+
 FIntVector AVoxelWorld::WorldLocationToChunkID(FVector WorldLocation) const
 {
 	if (WorldLocation.Z == -0.0f)
@@ -282,13 +349,158 @@ void AVoxelWorld::SculptInWorld_Symmetrical(UVoxelChunk* TargetChunk, UVoxelBrus
 		}
 	}
 	
+	// Every chunk the brush reaches is one step in the undo history
+	FVoxelEditJournal* EditJournal = GetJournal();
+	if (EditJournal) EditJournal->BeginEdit();
+	TSet<UVoxelChunk*> ChunksToUpdate;
 	for (const TPair<UVoxelChunk*, UVoxelBrush*>& Op : OpsMap)
 	{
 		UVoxelChunk* ChunkToSculpt = Op.Key;
-		UVoxelBrush* Brush = Op.Value;
+		ChunkToSculpt->Sculpt(Op.Value);
+		AddChunksToUpdate(ChunkToSculpt, ChunksToUpdate);
+	}
+	if (EditJournal) EditJournal->EndEdit();
+
+	for (UVoxelChunk* ChunkToUpdate : ChunksToUpdate)
+	{
+		ChunkToUpdate->Update();
+	}
+}
+
+void AVoxelWorld::AddChunksToUpdate(UVoxelChunk* Chunk, TSet<UVoxelChunk*>& ChunksToUpdate)
+{
+	ChunksToUpdate.Add(Chunk);
+
+	// Dual meshers close the seams towards the high faces with the voxels of the chunks there
+	if (MesherType != EVoxelMesherType::MarchingCubes)
+	{
+		for (int i = 1; i < 8; i++)
+		{
+			if (UVoxelChunk* Neighbour = FindChunk(Chunk->ChunkID - FIntVector(i & 1, i >> 1 & 1, i >> 2))) ChunksToUpdate.Add(Neighbour);
+		}
+		return;
+	}
+
+	// Marching cubes normals read a step past the chunk faces, so the face neighbours remesh the voxels along them
+	FIntVector DirtyMin, DirtyMax;
+	if (!Chunk->GetDirtyRegion(DirtyMin, DirtyMax)) return;
+	const int Cells = Chunk->Size - 1;
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		for (int Side = -1; Side <= 1; Side += 2)
+		{
+			FIntVector Offset = FIntVector::ZeroValue;
+			Offset[Axis] = Side;
+			UVoxelChunk* Neighbour = FindChunk(Chunk->ChunkID + Offset);
+			if (!Neighbour || Neighbour->Size != Chunk->Size) continue;
+
+			const int Apron = 1 << Neighbour->Lod;
+			if (Side < 0 ? DirtyMin[Axis] > Apron : DirtyMax[Axis] < Cells - Apron) continue;
+			FIntVector NeighbourMin = DirtyMin - Offset * Cells;
+			FIntVector NeighbourMax = DirtyMax - Offset * Cells;
+			NeighbourMin[Axis] = FMath::Clamp(NeighbourMin[Axis], 0, Cells);
+			NeighbourMax[Axis] = FMath::Clamp(NeighbourMax[Axis], 0, Cells);
+			Neighbour->MarkDirty(NeighbourMin, NeighbourMax);
+			ChunksToUpdate.Add(Neighbour);
+		}
+	}
+}
+
+bool AVoxelWorld::Undo()
+{
+	const TArray<FVoxelChunkDelta>* Deltas = Journal.Undo();
+	if (!Deltas) return false;
+	ApplyDeltas(*Deltas);
+	return true;
+}
+
+bool AVoxelWorld::Redo()
+{
+	const TArray<FVoxelChunkDelta>* Deltas = Journal.Redo();
+	if (!Deltas) return false;
+	ApplyDeltas(*Deltas);
+	return true;
+}
+
+void AVoxelWorld::ClearUndoHistory()
+{
+	Journal.Empty();
+}
+
+FVoxelEditJournal* AVoxelWorld::GetJournal()
+{
+	if (UndoMemoryMB <= 0) return nullptr;
+	Journal.SetMaxBytes(static_cast<int64>(UndoMemoryMB * 1024 * 1024));
+	return &Journal;
+}
+
+TSharedRef<const FVoxelGenerator, ESPMode::ThreadSafe> AVoxelWorld::GetGenerator()
+{
+	TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe> Graph;
+	if (GeneratorGraph) Graph = GeneratorGraph->GetProgram(Seed);
+	// Never changed in place, chunks still generating keep the one they started with
+	if (!GeneratorInstance || GeneratorInstance->GetSeed() != Seed || GeneratorInstance->GetGraph() != Graph)
+	{
+		GeneratorInstance = MakeShared<FVoxelGenerator, ESPMode::ThreadSafe>(Seed, Graph);
+	}
+	return GeneratorInstance.ToSharedRef();
+}
+
+void AVoxelWorld::ApplyDeltas(TArray<FVoxelChunkDelta> Deltas)
+{
+	TSet<UVoxelChunk*> ChunksToUpdate;
+	for (const FVoxelChunkDelta& Delta : Deltas)
+	{
+		UVoxelChunk* Chunk = FindChunk(Delta.ChunkID);
+		if (!Chunk) continue;
+		if (!Chunk->ApplyDelta(Delta))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("VoxelWorld: undo step does not fit chunk %s any more"), *Delta.ChunkID.ToString());
+			continue;
+		}
+		AddChunksToUpdate(Chunk, ChunksToUpdate);
+	}
+
+	for (UVoxelChunk* ChunkToUpdate : ChunksToUpdate)
+	{
+		ChunkToUpdate->Update();
+	}
+}
+
+void AVoxelWorld::UpdateLods(const FVector ViewLocation)
+{
+	const FIntVector ViewChunkID = WorldLocationToChunkID(ViewLocation);
+
+	// Rings at least a chunk wide keep face neighbours within one level of each other, which the transition cells rely on
+	const int Radius = FMath::Max(1, LodChunkRadius);
+	const int WorldMaxLod = MesherType == EVoxelMesherType::MarchingCubes ? MaxLod : 0;
+	TMap<FIntVector, int> Lods;
+	for (const TPair<FIntVector, UVoxelChunk*>& Chunk : Chunks)
+	{
+		const FIntVector Delta = Chunk.Key - ViewChunkID;
+		const int Distance = FMath::Max3(FMath::Abs(Delta.X), FMath::Abs(Delta.Y), FMath::Abs(Delta.Z));
+		Lods.Add(Chunk.Key, FMath::Clamp(Distance / Radius, 0, WorldMaxLod));
+	}
+
+	const FIntVector FaceOffsets[6] = {
+		FIntVector(-1, 0, 0), FIntVector(1, 0, 0),
+		FIntVector(0, -1, 0), FIntVector(0, 1, 0),
+		FIntVector(0, 0, -1), FIntVector(0, 0, 1)
+	};
+
+	for (const TPair<FIntVector, UVoxelChunk*>& Chunk : Chunks)
+	{
+		if (!Chunk.Value) continue;
+
+		const int Lod = Lods[Chunk.Key];
+		ETransitionFace TransitionFaces = ETransitionFace::None;
+		for (int Face = 0; Face < 6; Face++)
+		{
+			const int* NeighbourLod = Lods.Find(Chunk.Key + FaceOffsets[Face]);
+			if (NeighbourLod && *NeighbourLod < Lod) TransitionFaces |= static_cast<ETransitionFace>(1 << Face);
+		}
 
-		ChunkToSculpt->Sculpt(Brush);
-		ChunkToSculpt->Update();
+		if (Chunk.Value->SetLod(Lod, TransitionFaces)) Chunk.Value->Update();
 	}
 }
 
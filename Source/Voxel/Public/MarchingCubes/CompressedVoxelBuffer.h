@@ -0,0 +1,49 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "VoxelData.h"
+#include <atomic>
+
+// The voxels of one plane across an axis, Size * Size of them along the other two axes in X, Y, Z order
+struct FVoxelPlane
+{
+	TArray<int16> Densities;
+	TArray<uint8> Materials;
+};
+
+// An FVoxelBuffer packed for a chunk nobody has touched in a while. Materials are runs of indices into a palette of the
+// materials the chunk uses. Densities are stored as the difference to a guess from the voxels before them and
+// compressed with LZ4, the smooth distance fields the generator and the brushes leave behind are mostly guessed right.
+// Voxels are always packed in linear order and laid out again when they are unpacked.
+class VOXEL_API FCompressedVoxelBuffer
+{
+	int Size = 0;
+	int NumVoxels = 0;
+	EVoxelLayout Layout = EVoxelLayout::Linear;
+	TArray<uint8> Palette;
+	// Run length << 8 | index into the palette, longer runs are split
+	TArray<uint32> MaterialRuns;
+	static constexpr int MaxRunLength = (1 << 24) - 1;
+	TArray<uint8> Densities;
+	// False if LZ4 could not make the differences any smaller, they are kept as they are then
+	bool bDensitiesCompressed = false;
+	// Planes handed out by GetVoxel so far, by Axis * Size + Coordinate. Set once and left alone until the voxels are
+	// packed again, so they are looked up without the lock.
+	TUniquePtr<std::atomic<const FVoxelPlane*>[]> PlaneSlots;
+	mutable TArray<TUniquePtr<FVoxelPlane>> Planes;
+	mutable FCriticalSection PlaneLock;
+
+	void CompressLinear(const FVoxelBuffer& Voxels);
+	bool DecompressLinear(FVoxelBuffer& OutVoxels) const;
+	static uint16 PredictDensity(const int16* Values, int X, int Y, int Z, int Stride);
+	const FVoxelPlane& GetPlane(int Axis, int Coordinate) const;
+public:
+	void Compress(const FVoxelBuffer& Voxels);
+	// Returns false and leaves OutVoxels empty if the densities don't unpack
+	bool Decompress(FVoxelBuffer& OutVoxels) const;
+	// One voxel, read off the plane through it across Axis. The first read of a plane unpacks the voxels into a scratch
+	// buffer to take it out, later ones come from the plane. Safe to call from several threads at once.
+	FVoxel GetVoxel(int X, int Y, int Z, int Axis) const;
+	void Empty();
+	bool IsEmpty() const { return NumVoxels == 0; }
+	int64 GetAllocatedSize() const;
+};
@@ -4,9 +4,9 @@
 class FMarchingCubes {
 
 public:
-    const float IsoLevel = 0.00001f;
+    static constexpr float IsoLevel = 0.00001f;
 
-    const int EdgeTable[256] = {
+    static constexpr int EdgeTable[256] = {
        0x0  , 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c,
        0x80c, 0x905, 0xa0f, 0xb06, 0xc0a, 0xd03, 0xe09, 0xf00,
        0x190, 0x99 , 0x393, 0x29a, 0x596, 0x49f, 0x795, 0x69c,
@@ -41,7 +41,7 @@ public:
        0x70c, 0x605, 0x50f, 0x406, 0x30a, 0x203, 0x109, 0x0
     };
 
-    const int TriTable[256][16] =
+    static constexpr int TriTable[256][16] =
     { {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
     {0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
     {0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
@@ -299,6 +299,10 @@ public:
     {0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1} };
 
-    void InsertTrianglesOfCube(FVector* P, float* Val, TArray<FVector>& Triangles) const;
-    FVector InterpolateVertex(float Iso, FVector P1, FVector P2, float ValP1, float ValP2) const;
+    static int GetCubeIndex(const float* Val);
+    static int GetTriangleCount(int CubeIndex);
+    static void InsertTrianglesOfCube(int CubeIndex, const int32* EdgeVertices, TArray<int>& Triangles);
+    static FVector InterpolateVertex(float Iso, FVector P1, FVector P2, float ValP1, float ValP2);
+    // Where InterpolateVertex puts the vertex, as a fraction of the way from P1 to P2
+    static float GetCrossing(float Iso, float ValP1, float ValP2);
 };
\ No newline at end of file
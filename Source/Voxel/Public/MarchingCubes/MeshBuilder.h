@@ -2,24 +2,128 @@
 #include "MarchingCubes.h"
 #include "MeshData.h"
 #include "VoxelData.h"
+#include "VoxelSummary.h"
+#include "VoxelMesher.h"
 
-class FMCMeshBuilder
+class FMCMeshBuilder : public FVoxelMesher
 {
 private:
-	FMarchingCubes MarchingCubes;
-	TMap<int, FVector> IndexToVertex;
-	TMap<int, FVector> IndexToNormal;
-	TMap<FVector, int> VertexToIndex;
-	TArray<int32> Triangles;
-	FVector Pos[8];
-	float W[8] = {};
+	// The grid edge a vertex was interpolated on, its normal is worked out from here once all vertices are known
+	struct FEdgeCrossing
+	{
+		// Lower end of the edge in voxels, the upper end lies Step voxels further along Axis
+		FIntVector Lower;
+		int Axis;
+		int Step;
+		float T;
+	};
 
+	// A range of cell layers meshed independently into its own buffers
+	struct FSlab
+	{
+		int ZBegin = 0;
+		int ZEnd = 0;
+		FMCMesh Mesh;
+		// One per vertex of the mesh
+		TArray<FEdgeCrossing> Crossings;
+		// Cells the surface passes through and their cube index, in meshing order
+		TArray<int32> ActiveCells;
+		TArray<uint8> ActiveCubes;
+		// One bit per corner that is inside the surface, for the planes below [0] and above [1] the current layer of cells
+		TArray<uint64> PlaneMasks[2];
+		// One bit per cell of the blocks that straddle the iso level, per row of blocks in the current layer of blocks
+		TArray<uint64> BlockMasks;
+		// Vertex ids per grid edge. X/Y edges are kept for the lower [0] and upper [1] plane of the
+		// current layer of cells, Z edges for the layer itself, so every shared edge is interpolated once.
+		TArray<int32> XEdges[2];
+		TArray<int32> YEdges[2];
+		TArray<int32> ZEdges;
+		// Vertices created on the chunk faces as edge key and slab-local id, for the transition cells to share
+		TArray<TPair<int64, int32>> BoundaryEdges;
+		FVector Pos[8];
+		float W[8] = {};
+	};
+
+	// Where a slab ended up in the output, kept with the builder so an incremental build can take it out again
+	struct FSlabPart
+	{
+		// The triangles as the slab emitted them, with slab-local and shared ids
+		TArray<int> Triangles;
+		TArray<int32> OutputVertices;
+		TArray<int32> OutputTriangles;
+		// Output ids of the vertices on the top plane, sorted by the shared id the slab above refers to them by
+		TArray<TPair<int32, int32>> TopVertices;
+	};
+
+	// Everything a build only needs while it runs
+	struct FWorkspace
+	{
+		// Only ever grows, so the buffers of every slab stay around for the next chunk
+		TArray<FSlab> Slabs;
+		// The corners sampled at the current level of detail
+		FVoxelBuffer LodData;
+		TMap<int64, int32> BoundaryEdges;
+		// Transition cells are built after the regular cells have been written out, their own vertices are referenced
+		// as -2 - local id until they are written out too
+		FMCMesh TransitionMesh;
+		TArray<FEdgeCrossing> TransitionCrossings;
+		TArray<int32> TransitionIds;
+		TArray<int32> TransitionTriangles;
+		TArray<int> OutputIndices;
+	};
+
+	// Cell layers per slab, slabs are meshed in parallel and stitched back together in order
+	static constexpr int SlabLayers = 8;
+	// Depth of the transition cells as a fraction of a cell at the meshed level of detail
+	static constexpr float TransitionWidth = 0.5f;
+
+	// Voxels between the sampled corners at the current level of detail
+	int Step = 1;
+	ETransitionFace Transitions = ETransitionFace::None;
+	TArray<FSlabPart> Parts;
+	// The parts still describe the output of the last build, which was at full detail
+	bool bSlabsCached = false;
+	int CachedSize = 0;
+
+	static void PrepareSlabs(FWorkspace& Workspace, int NumSlabs, int GridCells);
+	void BuildSlab(const FVoxelBuffer& Data, int Size, const FVoxelSummary* Summary, FSlab& Slab) const;
+	void StitchSlab(FWorkspace& Workspace, int Index, FVoxelMeshOutput& Output, bool bAppendVertices = true);
+	bool BuildDirtySlabs(FWorkspace& Workspace, const FVoxelMeshInput& Input, FVoxelMeshOutput& Output);
+	void SampleLod(FWorkspace& Workspace, const FVoxelBuffer& Data, int Size, int LodSize) const;
+	// The helpers of the cell loops take the layout of Data, resolved once with VisitLayout before the loop starts
+	template <typename LayoutType>
+	void BuildTransitionCells(FWorkspace& Workspace, const FVoxelBuffer& Data, LayoutType Layout, int Size, int Face) const;
+	template <typename LayoutType>
+	int GetTransitionVertex(FWorkspace& Workspace, const FVoxelBuffer& Data, LayoutType Layout, int Size, const FIntVector& A, const FIntVector& B, float ValA, float ValB, bool bCoarse) const;
+	FVector DisplaceVertex(const FVector& V, int Cells) const;
+	bool GetBlockMasks(const FVoxelSummary* Summary, int BlockZ, int Size, uint64* OutMasks) const;
+	void ClassifyPlane(const FVoxelBuffer& Data, int Z, int Size, uint64* OutMasks) const;
+	static uint64 GetMixedCells(const uint64* R00, const uint64* R10, const uint64* R01, const uint64* R11, int Word, int Words);
 	static void SetVectors(FVector* V, float X, float Y, float Z);
-	void AddTriangle(FVector V1, FVector V2, FVector V3);
-	int InsertVertex(FVector V, FVector Normal);
-	static FVector ComputeNormal(FVector V1, FVector V2, FVector V3);
+	template <typename LayoutType>
+	static void GatherDensities(const FVoxelBuffer& Data, LayoutType Layout, int X, int Y, int Z, int Size, float* W);
+	template <typename LayoutType>
+	int GetEdgeVertex(FSlab& Slab, const FVoxelBuffer& Data, LayoutType Layout, int Size, int Edge, int X, int Y, int Z) const;
+	template <typename LayoutType>
+	static int AddVertex(FMCMesh& Mesh, TArray<FEdgeCrossing>& Crossings, const FVoxelBuffer& Data, LayoutType Layout, int Size, const FVector& V, int VertexStep, const FEdgeCrossing& Crossing);
+	static void ComputeNormals(const FVoxelMeshInput& Input, const TArray<FEdgeCrossing>& Crossings, TArray<FVector3f>& OutNormals);
+	template <typename LayoutType>
+	static void ComputeNormals(const FVoxelMeshInput& Input, LayoutType Layout, const TArray<FEdgeCrossing>& Crossings, TArray<FVector3f>& OutNormals);
+	template <typename LayoutType>
+	static float GetDifference(const FVoxelMeshInput& Input, LayoutType Layout, const FIntVector& Voxel, int Axis, int Distance);
+	// The density of a voxel up to one step off the chunk along Axis, read from the chunk past that face.
+	// False if that chunk is missing.
+	template <typename LayoutType>
+	static bool FindDensity(const FVoxelMeshInput& Input, LayoutType Layout, FIntVector Voxel, int Axis, float& OutDensity);
+	static int GetOwnedEdges(int X, int Y, int Cells, bool bTopLayer, bool bSharedBottom);
+	static int GetMaskWords(int Size);
+	static bool GetBit(const uint64* Mask, int X);
 	static int GetIndex(int X, int Y, int Z, int Size);
+	static int64 GetEdgeKey(const FIntVector& Lower, int Axis, bool bCoarse, int Size);
 public:
-	FMCMesh Build(FVoxel* Data, int Size);
+	using FVoxelMesher::Build;
+	// Lod meshes every 2^Lod-th voxel, TransitionFaces are stitched to neighbours one level finer
+	virtual void Build(const FVoxelMeshInput& Input, FVoxelMeshOutput& Output) override;
+	FMCMesh Build(const FVoxelBuffer& Voxels, int Size, const FVoxelSummary* Summary = nullptr, int Lod = 0, ETransitionFace TransitionFaces = ETransitionFace::None);
 };
 
@@ -5,8 +5,10 @@ class FMCMesh
 {
 public:
 	FMCMesh();
+	// Empties the mesh but keeps the memory for the next one
+	void Reset();
 	TArray<FVector> Vertices;
-	TArray<FVector> Normals;
+	TArray<FVector3f> Normals;
 	TArray<FLinearColor> Colors;
 	TArray<int> Triangles;
 };
@@ -0,0 +1,58 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "MarchingCubes/MeshData.h"
+
+// Simplifies a finished chunk mesh by collapsing edges in order of their quadric error until it is down to a triangle
+// budget. A vertex only ever collapses onto one of its neighbours, which keeps its position, normal and color.
+class VOXEL_API FMeshDecimator
+{
+	// Sum of the squared distances to the planes of the triangles a vertex stands for, weighted by their area
+	struct FQuadric
+	{
+		double XX = 0, XY = 0, XZ = 0, XW = 0, YY = 0, YZ = 0, YW = 0, ZZ = 0, ZW = 0, WW = 0;
+
+		void AddPlane(const FVector& Normal, double W, double Weight);
+		void Add(const FQuadric& Other);
+		double Evaluate(const FVector& P) const;
+	};
+
+	struct FCollapse
+	{
+		double Cost;
+		int32 From;
+		int32 To;
+		// Stamps of both vertices when the cost was taken, the collapse is stale once either moved on
+		int32 FromStamp;
+		int32 ToStamp;
+
+		bool operator<(const FCollapse& Other) const { return Cost < Other.Cost; }
+	};
+
+	// Keeps triangles from folding over, their normals may turn by at most this much in one collapse
+	static constexpr double MinNormalCosine = 0.2;
+
+	FMCMesh& Mesh;
+	FBox Bounds;
+	TArray<FQuadric> Quadrics;
+	TArray<TArray<int32, TInlineAllocator<8>>> VertexTriangles;
+	// Bumped whenever the quadric or the triangles of a vertex change, INDEX_NONE once it is collapsed away
+	TArray<int32> Stamps;
+	TArray<bool> Locked;
+	TArray<bool> RemovedTriangles;
+	TArray<FCollapse> Heap;
+
+	void Init();
+	void LockVertices();
+	void QueueCollapses(int32 A, int32 B);
+	void QueueNeighbours(int32 Vertex);
+	void GetNeighbours(int32 Vertex, TArray<int32, TInlineAllocator<16>>& OutNeighbours) const;
+	bool CanCollapse(int32 From, int32 To) const;
+	int Collapse(int32 From, int32 To);
+	void Compact();
+	bool IsOnBounds(const FVector& P) const;
+public:
+	// Vertices on the faces of Bounds, on open edges or next to a vertex of another material never move, so the seams
+	// with the neighbouring chunks and the material borders stay where the mesher put them
+	FMeshDecimator(FMCMesh& InMesh, const FBox& InBounds);
+	void Decimate(int TargetTriangleCount);
+};
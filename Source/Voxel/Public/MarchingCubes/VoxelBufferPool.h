@@ -0,0 +1,31 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "VoxelData.h"
+
+// Voxels as they were when they were handed out, safe to read from any thread while the owner moves on to a copy
+using FVoxelSnapshot = TSharedRef<const FVoxelBuffer, ESPMode::ThreadSafe>;
+
+// Keeps the arrays of chunk voxel buffers that were let go, so chunks streaming in and out take over the blocks of the
+// ones that left instead of asking the heap for a few hundred kilobytes every time. Buffers are only handed out again
+// at exactly the length they had, every chunk of a world has the same size.
+class VOXEL_API FVoxelBufferPool
+{
+public:
+	// Free buffers kept per length, anything past that goes back to the heap
+	static constexpr int MaxFreeBuffers = 32;
+
+	static FVoxelBufferPool& Get();
+
+	// Sizes Buffer like FVoxelBuffer::Init, reusing a free buffer of the same length if there is one.
+	// The voxels are left as they were, callers fill them.
+	void Allocate(FVoxelBuffer& Buffer, int Size, EVoxelLayout Layout);
+	// Takes the arrays of Buffer and leaves it empty
+	void Release(FVoxelBuffer& Buffer);
+	// A buffer that goes back to the pool when the last reference to it is dropped
+	TSharedRef<FVoxelBuffer, ESPMode::ThreadSafe> AllocateShared(int Size, EVoxelLayout Layout);
+	int64 GetFreeBytes() const;
+private:
+	mutable FCriticalSection Lock;
+	// By number of voxels
+	TMap<int, TArray<FVoxelBuffer>> FreeBuffers;
+};
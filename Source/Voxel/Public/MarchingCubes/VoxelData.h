@@ -1,16 +1,11 @@
 ﻿#pragma once
 
+#include "Async/ParallelFor.h"
 #include "VoxelData.generated.h"
 
 /*
- * Used for storing voxels since blueprints don't support 8 bit integer
+ * A single voxel as Blueprints see it, chunks keep their voxels in an FVoxelBuffer
  */
-struct Voxel
-{
-	float Density;
-	int8 Id;
-};
-
 USTRUCT(Blueprintable)
 struct FVoxel
 {
@@ -27,3 +22,105 @@ struct FVoxel
 	UPROPERTY(BlueprintReadOnly)
 	int Id;
 };
+
+UENUM(BlueprintType)
+enum class EVoxelLayout : uint8
+{
+	// Rows along X one after the other, what the meshers scan fastest
+	Linear,
+	// 8x8x8 bricks, so the voxels around one mostly sit in the same few cache lines
+	Bricks
+};
+
+// Voxel X + Size * (Y + Size * Z)
+struct FLinearVoxelLayout
+{
+	static int GetNumVoxels(const int Size) { return Size * Size * Size; }
+	static int GetIndex(const int X, const int Y, const int Z, const int Size) { return X + Size * (Y + Size * Z); }
+};
+
+// Bricks in linear order, the voxels of a brick in Morton order. The last bricks along each axis are padded.
+struct FBrickVoxelLayout
+{
+	static constexpr int BrickSize = 8;
+
+	static int GetBricks(const int Size) { return (Size + BrickSize - 1) / BrickSize; }
+	static int GetNumVoxels(const int Size) { return GetBricks(Size) * GetBricks(Size) * GetBricks(Size) * BrickSize * BrickSize * BrickSize; }
+	static int GetIndex(const int X, const int Y, const int Z, const int Size)
+	{
+		// The three bits of each coordinate inside the brick, spread out to every third bit
+		static constexpr int Spread[BrickSize] = {0, 1, 8, 9, 64, 65, 72, 73};
+		const int Bricks = GetBricks(Size);
+		const int Brick = X / BrickSize + Bricks * (Y / BrickSize + Bricks * (Z / BrickSize));
+		return Brick * (BrickSize * BrickSize * BrickSize) + Spread[X % BrickSize] + (Spread[Y % BrickSize] << 1) + (Spread[Z % BrickSize] << 2);
+	}
+};
+
+/*
+ * The voxels of a chunk, with densities and materials in arrays of their own so scans over the densities stay dense.
+ * Densities are signed distances in voxels, stored in steps of DensityStep and clamped to what an int16 holds.
+ * Voxels are found through GetIndex, or through the layout VisitLayout hands to a loop that runs over many of them.
+ */
+struct VOXEL_API FVoxelBuffer
+{
+	static constexpr float DensityStep = 1.0f / 256;
+
+	TArray<int16> Densities;
+	TArray<uint8> Materials;
+	// Voxels along each axis
+	int Size = 0;
+	EVoxelLayout Layout = EVoxelLayout::Linear;
+
+	void Init(int InSize, EVoxelLayout InLayout = EVoxelLayout::Linear);
+	void Empty();
+	// Includes the padding of the layout
+	int Num() const { return Densities.Num(); }
+	static int GetNumVoxels(int InSize, EVoxelLayout InLayout);
+	int GetIndex(const int X, const int Y, const int Z) const
+	{
+		return Layout == EVoxelLayout::Bricks ? FBrickVoxelLayout::GetIndex(X, Y, Z, Size) : FLinearVoxelLayout::GetIndex(X, Y, Z, Size);
+	}
+	// Calls Function with the layout of the buffer, so the loop it runs is compiled for that layout alone
+	template <typename FunctionType>
+	decltype(auto) VisitLayout(FunctionType&& Function) const
+	{
+		return Layout == EVoxelLayout::Bricks ? Function(FBrickVoxelLayout()) : Function(FLinearVoxelLayout());
+	}
+	// Fills the buffer one Z plane per task. FillPlane(Z, SetVoxel) runs on the task of each plane and sets its voxels
+	// through SetVoxel(X, Y, Density, Material), best with X innermost since that is the order they are stored in.
+	template <typename FunctionType>
+	void FillPlanes(FunctionType&& FillPlane)
+	{
+		VisitLayout([this, &FillPlane](const auto VoxelLayout)
+		{
+			ParallelFor(Size, [this, &FillPlane, VoxelLayout](const int32 Z)
+			{
+				FillPlane(Z, [this, VoxelLayout, Z](const int X, const int Y, const float Density, const uint8 Material)
+				{
+					const int Index = VoxelLayout.GetIndex(X, Y, Z, Size);
+					Densities[Index] = QuantizeDensity(Density);
+					Materials[Index] = Material;
+				});
+			});
+		});
+	}
+	int64 GetAllocatedSize() const { return Densities.GetAllocatedSize() + Materials.GetAllocatedSize(); }
+
+	float GetDensity(const int Index) const { return Densities[Index] * DensityStep; }
+	void SetDensity(const int Index, const float Density) { Densities[Index] = QuantizeDensity(Density); }
+	FVoxel GetVoxel(const int Index) const { return FVoxel(GetDensity(Index), Materials[Index]); }
+	void SetVoxel(const int Index, const FVoxel& Voxel);
+	void Fill(const FVoxel& Voxel);
+	// Copies every voxel of Source into the same place of this buffer, which has to be as large but may be laid out differently
+	void CopyVoxels(const FVoxelBuffer& Source);
+	// True when every voxel holds the same density and material
+	bool IsUniform() const;
+
+	// Inline, the generator and the brushes quantize every voxel they write
+	static int16 QuantizeDensity(const float Density)
+	{
+		return static_cast<int16>(FMath::Clamp(FMath::RoundToInt(Density / DensityStep), -static_cast<int32>(MAX_int16), static_cast<int32>(MAX_int16)));
+	}
+	// A stored density is below IsoLevel exactly when it is below this
+	static int16 QuantizeIsoLevel(float IsoLevel);
+};
@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include "VoxelData.h"
+
+/*
+ * Min/max density per block of cells, so blocks that are all air or all solid can be skipped without touching their voxels.
+ * A block covers the corner voxels of its cells, neighbouring blocks share the voxels on the plane between them.
+ */
+class VOXEL_API FVoxelSummary
+{
+public:
+	// Cells per block along each axis
+	static constexpr int BlockSize = 8;
+
+	// Sizes the summary for a chunk, every block counts as mixed until the first update
+	void Init(int Size);
+	void Update(const FVoxelBuffer& Voxels);
+	// Recomputes the blocks covering the voxels between Min and Max, inclusive
+	void Update(const FVoxelBuffer& Voxels, const FIntVector& Min, const FIntVector& Max);
+	// Every voxel of the chunk holds Density
+	void Fill(float Density);
+
+	int GetBlocks() const;
+	float GetMinDensity(int X, int Y, int Z) const;
+	float GetMaxDensity(int X, int Y, int Z) const;
+	// True when the block has voxels on both sides of the iso level, only those blocks can hold triangles
+	bool IsBlockMixed(int X, int Y, int Z, float IsoLevel) const;
+	bool HasSurface(float IsoLevel) const;
+private:
+	int Size = 0;
+	int Blocks = 0;
+	TArray<float> MinDensity;
+	TArray<float> MaxDensity;
+	float ChunkMinDensity = 0;
+	float ChunkMaxDensity = 0;
+
+	void UpdateBlock(const FVoxelBuffer& Voxels, int X, int Y, int Z);
+	int GetBlockIndex(int X, int Y, int Z) const;
+};
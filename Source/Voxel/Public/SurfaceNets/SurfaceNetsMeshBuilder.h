@@ -0,0 +1,41 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "VoxelMesher.h"
+#include "MarchingCubes/MeshData.h"
+
+// Dual mesher, places one vertex in every cell the surface passes through and connects the cells around each crossed edge
+class FSurfaceNetsMeshBuilder : public FVoxelMesher
+{
+private:
+	// Pulls dual contouring vertices towards the mass point so flat and degenerate cells stay well defined
+	static constexpr float Regularization = 0.05f;
+
+	// Everything a build only needs while it runs
+	struct FWorkspace
+	{
+		// The chunk voxels plus one layer from the neighbours past the high faces
+		TArray<float> Densities;
+		TArray<int> Ids;
+		TArray<int32> CellVertices;
+		FMCMesh Mesh;
+		TArray<int32> OutputIds;
+	};
+
+	bool bDualContouring;
+	int Cells = 0;
+	int Samples = 0;
+
+	bool GatherSamples(FWorkspace& Workspace, const FVoxelMeshInput& Input);
+	bool IsCellAvailable(int X, int Y, int Z, const FVoxelMeshInput& Input) const;
+	int AddCellVertex(FWorkspace& Workspace, int X, int Y, int Z, const float* W) const;
+	static void AddQuad(FMCMesh& Mesh, int32 A, int32 B, int32 C, int32 D, bool bFlip);
+	static FVector GetGradient(const float* W, const FVector& P);
+	static FVector SolveQef(const FVector* Points, const FVector* Normals, int Count, const FVector& MassPoint);
+	int GetIndex(int X, int Y, int Z) const;
+	int GetCellIndex(int X, int Y, int Z) const;
+public:
+	explicit FSurfaceNetsMeshBuilder(bool bInDualContouring);
+	using FVoxelMesher::Build;
+	// Ignores the level of detail, the faces shared with missing neighbours are left open
+	virtual void Build(const FVoxelMeshInput& Input, FVoxelMeshOutput& Output) override;
+};
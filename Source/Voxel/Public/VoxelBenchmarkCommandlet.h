@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MarchingCubes/VoxelData.h"
+#include "VoxelBenchmarkCommandlet.generated.h"
+
+// Times generation, meshing and sculpting on fixed voxel fields and writes the results as CSV and JSON.
+// Runs headless: UnrealEditor-Cmd Voxel.uproject -run=VoxelBenchmark -nullrhi [-sizes=17,33,65] [-iterations=20] [-layout=Bricks]
+// [-csv=Path] [-json=Path] [-baseline=Path.csv] [-tolerance=0.1]
+// With a baseline CSV from an earlier run, any case that got slower than the tolerance allows makes it return 1.
+// Allocations and peak bytes count every thread of the process while a case runs, not only the one it runs on.
+UCLASS()
+class VOXEL_API UVoxelBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+	enum class EField : uint8
+	{
+		Plane,
+		Noise,
+		Sphere,
+		// Every other voxel inside, the most triangles a chunk can have
+		Checkerboard
+	};
+
+	struct FResult
+	{
+		FString Case;
+		FString Field;
+		int Size = 0;
+		int Iterations = 0;
+		double TotalMs = 0;
+		double MinMs = TNumericLimits<double>::Max();
+		int64 Triangles = 0;
+		int64 Allocations = 0;
+		int64 PeakBytes = 0;
+
+		double GetMsPerChunk() const { return Iterations > 0 ? TotalMs / Iterations : 0; }
+		double GetTrianglesPerSecond() const { return TotalMs > 0 ? Triangles / (TotalMs / 1000) : 0; }
+		FString GetKey() const { return FString::Printf(TEXT("%s,%s,%d"), *Case, *Field, Size); }
+	};
+
+	static const TCHAR* GetFieldName(EField Field);
+	static void FillField(EField Field, int Size, EVoxelLayout Layout, FVoxelBuffer& OutData);
+	static void Measure(FResult& Result, TFunctionRef<int()> Run);
+	static FString ToCsv(const TArray<FResult>& Results);
+	static FString ToJson(const TArray<FResult>& Results);
+	static int CompareWithBaseline(const TArray<FResult>& Results, const FString& BaselinePath, double Tolerance);
+public:
+	UVoxelBenchmarkCommandlet();
+	virtual int32 Main(const FString& Params) override;
+};
@@ -15,4 +15,5 @@ class VOXEL_API UBoxShape : public UVoxelShape
 	UPROPERTY(BlueprintReadWrite)
 	FVector Size = FVector(2, 2, 2);
 	virtual float SignedDistance(FVector& VoxelPosition, FVector& BrushPosition) override;
+	virtual FBox GetBounds(FVector& BrushPosition) override;
 };
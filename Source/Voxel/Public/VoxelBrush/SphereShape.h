@@ -15,4 +15,5 @@ public:
 	UPROPERTY(BlueprintReadWrite)
 	float Radius = 2.0;
 	virtual float SignedDistance(FVector& VoxelPosition, FVector& BrushPosition) override;
+	virtual FBox GetBounds(FVector& BrushPosition) override;
 };
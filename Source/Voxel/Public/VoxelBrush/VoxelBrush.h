@@ -25,4 +25,7 @@ public:
 	
 	void Paint(FVoxel& Voxel, FVector& VoxelPosition, int MaterialId);
 	void Sculpt(FVoxel& Voxel, FVector& VoxelPosition);
+	// Conservative tests whether any voxel inside Region can change, given the densities the region holds
+	bool CanPaint(const FBox& Region);
+	bool CanSculpt(const FBox& Region, float MinDensity, float MaxDensity);
 };
@@ -10,4 +10,6 @@ class VOXEL_API UVoxelShape : public UObject
 	GENERATED_BODY()
 public:
 	virtual float SignedDistance(FVector& VoxelPosition, FVector& BrushPosition);
+	// Box around every position with a negative distance, shapes without one affect the whole chunk
+	virtual FBox GetBounds(FVector& BrushPosition);
 };
@@ -5,10 +5,17 @@
 #include "VoxelStats.h"
 #include "Components/DynamicMeshComponent.h"
 #include "MarchingCubes/VoxelData.h"
+#include "MarchingCubes/CompressedVoxelBuffer.h"
+#include "MarchingCubes/VoxelBufferPool.h"
+#include "MarchingCubes/VoxelSummary.h"
+#include "VoxelMesher.h"
+#include "VoxelEditJournal.h"
 #include "VoxelBrush/VoxelBrush.h"
 
 #include "VoxelChunk.generated.h"
 
+class AVoxelWorld;
+
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class VOXEL_API UVoxelChunk : public USceneComponent
 {
@@ -18,9 +25,24 @@ public:
 	UPROPERTY(BlueprintReadOnly)
 	FVoxelStats Stats = FVoxelStats();
 	FVoxelStats& StatsRef = Stats;
-	FVoxel* Data;
+	// Kept in sync with the voxels by Generate and Sculpt, and kept around while they are compressed or uniform
+	FVoxelSummary Summary;
 	UPROPERTY(BlueprintReadWrite)
 	int Size = 65;
+	// Meshes every 2^Lod-th voxel, set by the world from the distance to the viewer
+	UPROPERTY(BlueprintReadOnly)
+	int Lod = 0;
+	ETransitionFace TransitionFaces = ETransitionFace::None;
+	UPROPERTY(BlueprintReadWrite)
+	EVoxelMesherType MesherType = EVoxelMesherType::MarchingCubes;
+	// How the dense voxels are laid out, takes effect the next time they are filled
+	UPROPERTY(BlueprintReadWrite)
+	EVoxelLayout Layout = EVoxelLayout::Linear;
+
+	// Set by the world that owns the chunk, dual meshers read the neighbours through it
+	UPROPERTY()
+	AVoxelWorld* World = nullptr;
+	FIntVector ChunkID = FIntVector::ZeroValue;
 	
 	UPROPERTY(BlueprintReadWrite)
 	UDynamicMeshComponent* MeshComponent;
@@ -29,6 +51,43 @@ public:
 	UMaterialInstance* Material;
 
 	UVoxelChunk();
+private:
+	// Null while the chunk is compressed or uniform. Shared with the snapshots taken since the last edit, the next edit
+	// copies it first.
+	TSharedPtr<FVoxelBuffer, ESPMode::ThreadSafe> Voxels;
+	FCompressedVoxelBuffer CompressedVoxels;
+	// Every voxel holds UniformVoxel, nothing else is stored until an edit breaks that
+	bool bUniform = true;
+	FVoxel UniformVoxel = FVoxel(1.0f, 0);
+	double LastVoxelAccess = 0;
+	// Kept between updates so the slabs of the last mesh can be reused
+	TUniquePtr<FVoxelMesher> Mesher;
+	EVoxelMesherType MesherBuiltFor = EVoxelMesherType::MarchingCubes;
+	// Voxels changed by Sculpt and Paint since the last update, only these are remeshed unless a full update is needed
+	bool bDirtyRegion = false;
+	FIntVector DirtyMin = FIntVector::ZeroValue;
+	FIntVector DirtyMax = FIntVector::ZeroValue;
+	bool bFullUpdate = true;
+	// Bumped whenever the voxels may change, voxels generated on a worker are dropped if it moved on in the meantime
+	int VoxelSerial = 0;
+	// Bumped by every update, a decimated mesh that comes back from a worker after the chunk was meshed again is dropped
+	int MeshSerial = 0;
+
+	void ApplyDecimatedMesh(const FMCMesh& Decimated);
+	void UpdateVoxelBytes();
+	void SetUniform(const FVoxel& Voxel);
+	bool TryCollapse();
+	// Drops the recorded edits of this chunk, once its voxels were replaced they no longer apply
+	void ForgetHistory() const;
+	// Fills Data from the generator of the world
+	void GenerateVoxels(FVoxelBuffer& Data);
+	// Makes sure Voxels holds the dense voxels, without copying them for an edit
+	void Unpack();
+	// Voxels for a mesher to read, a uniform chunk lends a buffer shared with every other chunk of the same value
+	const FVoxelBuffer& ReadVoxels();
+	// Voxels for the mesher of a chunk next to this one. Left packed if they are, and not counted as an access.
+	FVoxelNeighbour ReadBorder() const;
+	static FVoxelSnapshot GetUniformBuffer(int ChunkSize, const FVoxel& Voxel);
 protected:
 	virtual void BeginPlay() override;
 	virtual void BeginDestroy() override;
@@ -41,8 +100,33 @@ public:
 	void Sculpt(UVoxelBrush* VoxelBrush);
 	UFUNCTION(BlueprintCallable)
 	void Paint(UVoxelBrush* VoxelBrush, int MaterialId);
+	// Steps the voxels back or forward by one delta of the world's edit journal, false if it does not fit them
+	bool ApplyDelta(const FVoxelChunkDelta& Delta);
+	UFUNCTION(BlueprintCallable)
+	void Generate();
+	// Replaces the voxels with freshly generated ones, which may have been filled on another thread
+	void SetGeneratedVoxels(const TSharedRef<FVoxelBuffer, ESPMode::ThreadSafe>& NewVoxels, FVoxelSummary&& NewSummary, double GenerateTime);
+	int GetVoxelSerial() const { return VoxelSerial; }
+	UFUNCTION(BlueprintCallable)
+	void Update();
+	UFUNCTION(BlueprintCallable)
+	bool HasSurface() const;
 	UFUNCTION(BlueprintCallable)
-	void Generate() const;
+	FVoxel GetVoxel(FIntVector Position);
+	// Voxels to edit in place. Decompresses them first if the chunk has been idle long enough to be compressed, and
+	// copies them if a snapshot still holds them.
+	FVoxelBuffer& GetVoxels();
+	// The voxels as they are now, for readers on other threads. Later edits go to a copy and leave it as it is.
+	FVoxelSnapshot Snapshot();
 	UFUNCTION(BlueprintCallable)
-	void Update() const;
+	void Compress();
+	UFUNCTION(BlueprintPure)
+	bool IsCompressed() const { return !CompressedVoxels.IsEmpty(); }
+	UFUNCTION(BlueprintPure)
+	bool IsUniform() const { return bUniform; }
+	// Returns true when the chunk has to be updated for the new level of detail
+	bool SetLod(int NewLod, ETransitionFace NewTransitionFaces);
+	// Also used by the world for the voxels next to a sculpted neighbour, whose normals read across the face
+	void MarkDirty(const FIntVector& Min, const FIntVector& Max);
+	bool GetDirtyRegion(FIntVector& OutMin, FIntVector& OutMax) const;
 };
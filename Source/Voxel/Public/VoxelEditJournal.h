@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "MarchingCubes/VoxelData.h"
+
+// What one edit did to the voxels of one chunk, as the XOR of the voxels before and after it over the box they changed
+// in. Unchanged voxels are zero and compress away, and applying the same delta again undoes it, so one delta serves
+// both undo and redo.
+class VOXEL_API FVoxelChunkDelta
+{
+	int RawSize = 0;
+	// Density XORs of the box in x, y, z order, then the material XORs, LZ4 compressed unless that did not help.
+	// Between Capture and Record it holds the voxels captured instead, in the same order and uncompressed.
+	TArray<uint8> Data;
+	bool bCompressed = false;
+public:
+	FIntVector ChunkID = FIntVector::ZeroValue;
+	// The box the delta covers, inclusive
+	FIntVector Min = FIntVector::ZeroValue;
+	FIntVector Max = FIntVector::ZeroValue;
+
+	// Keeps the voxels of the box an edit can change, before it changes them
+	void Capture(const FVoxelBuffer& Before, const FIntVector& InMin, const FIntVector& InMax);
+	// Turns the captured voxels into the delta of the box the edit did change in, which lies inside the captured one
+	void Record(const FVoxelBuffer& After, const FIntVector& InMin, const FIntVector& InMax);
+	// Toggles Voxels between the two states recorded. Returns false if the delta does not fit them or does not unpack.
+	bool Apply(FVoxelBuffer& Voxels) const;
+	int64 GetAllocatedSize() const { return Data.GetAllocatedSize() + sizeof(FVoxelChunkDelta); }
+};
+
+/*
+ * Undo and redo history of sculpting and painting. An edit is every chunk delta recorded between BeginEdit and EndEdit,
+ * or a single delta recorded outside of them. The oldest edits are dropped once the history outgrows its budget.
+ * Deltas only apply to the voxels they were recorded on, anything that replaces the voxels of a chunk past the journal
+ * should forget that chunk, or clear the journal if it replaces every chunk.
+ */
+class VOXEL_API FVoxelEditJournal
+{
+	struct FEdit
+	{
+		TArray<FVoxelChunkDelta> Deltas;
+		int64 Bytes = 0;
+	};
+
+	TArray<FEdit> Edits;
+	// Edits before this one are applied, the ones from here on were undone and can be redone
+	int Current = 0;
+	int64 Bytes = 0;
+	int64 MaxBytes = 0;
+	bool bEditOpen = false;
+	FEdit OpenEdit;
+
+	void Commit(FEdit&& Edit);
+	// Drops the deltas of a chunk from an edit, returns the bytes they took
+	static int64 Forget(FEdit& Edit, const FIntVector& ChunkID);
+	void Trim();
+public:
+	void SetMaxBytes(int64 InMaxBytes);
+	void BeginEdit();
+	void EndEdit();
+	void Record(const FIntVector& ChunkID, FVoxelChunkDelta&& Delta);
+	// Drops every delta of a chunk and the edits left with none. The other chunks of an edit still undo together.
+	void ForgetChunk(const FIntVector& ChunkID);
+	// The deltas to apply to step back or forward, null if there is nothing to undo or redo
+	const TArray<FVoxelChunkDelta>* Undo();
+	const TArray<FVoxelChunkDelta>* Redo();
+	bool CanUndo() const { return Current > 0; }
+	bool CanRedo() const { return Current < Edits.Num(); }
+	void Empty();
+	int64 GetAllocatedSize() const { return Bytes; }
+};
@@ -4,17 +4,70 @@
 
 #include "Voxel/FastNoiseLite.h"
 #include "MarchingCubes/VoxelData.h"
+#include "MarchingCubes/VoxelSummary.h"
 #include "VoxelBrush/VoxelBrush.h"
 
-class FVoxelGenerator
+class FVoxelGraphProgram;
+
+// Terrain from a seed and an optional generator graph, fixed once constructed. Generating only reads it, so one
+// instance can be shared by any number of chunks generating on any threads, and worlds with their own instances never
+// see each other's settings.
+class VOXEL_API FVoxelGenerator
 {
 private:
-	static FastNoiseLite Noise;
+	struct FCachedHeightmap
+	{
+		TSharedPtr<const TArray<float>, ESPMode::ThreadSafe> Heights;
+		uint64 LastUse = 0;
+	};
+
+	const int32 Seed;
+	const TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe> Graph;
+	// Set up by the constructor and sampled by concurrent Generate calls, see the note above FastNoiseLite::GetNoise
+	mutable FastNoiseLite Noise;
+	// Heights are the noise at the voxel position times NoiseScale, mapped to BaseHeight +- HeightAmplitude
+	static constexpr float NoiseScale = 7;
+	static constexpr double HeightAmplitude = 4;
+	static constexpr double BaseHeight = 8;
+
+	// Heights are filled outside the lock and shared read-only
+	mutable FCriticalSection HeightmapLock;
+	mutable TMap<FVector, FCachedHeightmap> Heightmaps;
+	mutable uint64 HeightmapUses = 0;
+
+	static void GetBlockRange(int Block, int Blocks, int Size, int& OutBegin, int& OutEnd);
+	static void GrowRegion(int X, int Y, int Z, FIntVector& Min, FIntVector& Max);
+	float GetHeight(double X, double Y) const;
+	static int GetMaterial(double Z);
+	// Heights come from the heightmap of the column, each voxel only adds its own Z
+	void GenerateHeightfield(FVector Origin, int Size, FVoxelBuffer& Data) const;
 public:
-	static void Sculpt(FVoxel* Data, int Size, UVoxelBrush* VoxelBrush);
+	// Heights of the terrain over one column of chunks, Size * Size of them with X innermost
+	using FHeightmap = TSharedRef<const TArray<float>, ESPMode::ThreadSafe>;
+	// Columns of recent chunks are kept, so the chunks stacked above and below them reuse their heights
+	static constexpr int MaxCachedHeightmaps = 64;
+	static constexpr int32 DefaultSeed = 1337;
+
+	explicit FVoxelGenerator(int32 InSeed = DefaultSeed, const TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe>& InGraph = nullptr);
+	// The built in heightfield with the default seed, for chunks outside of a world
+	static TSharedRef<const FVoxelGenerator, ESPMode::ThreadSafe> GetDefault();
+
+	int32 GetSeed() const { return Seed; }
+	const TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe>& GetGraph() const { return Graph; }
+
+	// Only visits the blocks of the summary the brush can change, and refreshes the summary for the voxels it changed.
+	// Returns false if nothing changed, otherwise the changed voxels lie in [OutChangedMin, OutChangedMax].
+	static bool Sculpt(FVoxelBuffer& Data, int Size, UVoxelBrush* VoxelBrush, FVoxelSummary& Summary, FIntVector& OutChangedMin, FIntVector& OutChangedMax);
 	// static void Sculpt(FVoxel* Data, int Size, UVoxelBrush* VoxelBrush, FVector VoxelWorldLocation);
-	static void Paint(FVoxel* Data, int Size, UVoxelBrush* VoxelBrush, int MaterialId);
-	static void Generate(FVector Origin, int Size, FVoxel* Data);
-	static FVoxel GetVoxel(FVector Position);
-	static void Clear(FVoxel* Data, int Size);
+	static bool Paint(FVoxelBuffer& Data, int Size, UVoxelBrush* VoxelBrush, int MaterialId, const FVoxelSummary& Summary, FIntVector& OutChangedMin, FIntVector& OutChangedMax);
+	// The box of the blocks Sculpt and Paint would visit, so the voxels they can change are known before they run.
+	// Returns false if they would not visit any.
+	static bool GetSculptRegion(int Size, UVoxelBrush* VoxelBrush, const FVoxelSummary& Summary, FIntVector& OutMin, FIntVector& OutMax);
+	static bool GetPaintRegion(int Size, UVoxelBrush* VoxelBrush, const FVoxelSummary& Summary, FIntVector& OutMin, FIntVector& OutMax);
+	// From the graph when there is one, the built in heightfield otherwise
+	void Generate(FVector Origin, int Size, FVoxelBuffer& Data) const;
+	FHeightmap GetHeightmap(FVector Origin, int Size) const;
+	// A voxel of the built in heightfield
+	FVoxel GetVoxel(FVector Position) const;
+	static void Clear(FVoxelBuffer& Data, int Size);
 };
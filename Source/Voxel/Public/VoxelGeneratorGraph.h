@@ -0,0 +1,211 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Voxel/FastNoiseLite.h"
+#include "MarchingCubes/VoxelData.h"
+#include "VoxelGeneratorGraph.generated.h"
+
+class UVoxelGeneratorGraph;
+
+UENUM(BlueprintType)
+enum class EVoxelGraphOp : uint8
+{
+	Constant,
+	PositionX,
+	PositionY,
+	PositionZ,
+	// Noise at the nodes in A, B (and C), the voxel position where they are INDEX_NONE. Feeding in offset positions
+	// warps it.
+	Noise2D,
+	Noise3D,
+	// Distance from the nodes in A, B, C (the voxel position by default) to a sphere at Center with radius Value
+	Sphere,
+	// Distance to a box at Center reaching Extent out along each axis
+	Box,
+	// A and B combined, an input that is INDEX_NONE reads Value
+	Add,
+	Subtract,
+	Multiply,
+	Min,
+	Max,
+	// Min and Max of the nodes in A and B blended over a distance of Value, for unions and cuts without a crease
+	SmoothMin,
+	SmoothMax,
+	Abs,
+	Negate
+};
+
+UENUM(BlueprintType)
+enum class EVoxelNoiseType : uint8
+{
+	OpenSimplex2,
+	OpenSimplex2S,
+	Cellular,
+	Perlin,
+	ValueCubic,
+	Value
+};
+
+UENUM(BlueprintType)
+enum class EVoxelFractalType : uint8
+{
+	None,
+	FBm,
+	Ridged,
+	PingPong
+};
+
+USTRUCT(BlueprintType)
+struct VOXEL_API FVoxelGraphNoise
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	EVoxelNoiseType Type = EVoxelNoiseType::OpenSimplex2;
+	// Added to the seed of the world, nodes with different seeds make different noise from the same positions
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	int32 Seed = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	float Frequency = 0.01f;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	EVoxelFractalType Fractal = EVoxelFractalType::None;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel", meta = (ClampMin = "1"))
+	int32 Octaves = 3;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	float Lacunarity = 2.0f;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	float Gain = 0.5f;
+};
+
+USTRUCT(BlueprintType)
+struct VOXEL_API FVoxelGraphNode
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	EVoxelGraphOp Op = EVoxelGraphOp::Constant;
+	// Indices of the nodes the inputs come from, only ever earlier ones
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	int32 A = INDEX_NONE;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	int32 B = INDEX_NONE;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	int32 C = INDEX_NONE;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	float Value = 0.0f;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	FVector Center = FVector::ZeroVector;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	FVector Extent = FVector::OneVector;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	FVoxelGraphNoise Noise;
+};
+
+// Voxels where Node lies in [Min, Max) get Material
+USTRUCT(BlueprintType)
+struct VOXEL_API FVoxelMaterialRule
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	int32 Node = INDEX_NONE;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	float Min = -UE_BIG_NUMBER;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	float Max = UE_BIG_NUMBER;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	uint8 Material = 0;
+};
+
+/*
+ * A generator graph flattened into instructions in the order of their dependencies, with the nodes nothing reads left
+ * out. Every instruction runs over a whole row of voxels before the next one starts, so the op is switched on once per
+ * row and its loop has nothing else in it. Instructions that don't depend on Z run once per column of the chunk and
+ * are shared by every voxel above each other, like the heights of a heightfield.
+ * Immutable once compiled, so any number of chunks may be generated from it at once.
+ */
+class VOXEL_API FVoxelGraphProgram
+{
+	struct FInstruction
+	{
+		EVoxelGraphOp Op = EVoxelGraphOp::Constant;
+		int32 Out = INDEX_NONE;
+		// Registers, INDEX_NONE reads Value
+		int32 Inputs[3] = {INDEX_NONE, INDEX_NONE, INDEX_NONE};
+		float Value = 0.0f;
+		FVector3f Center = FVector3f::ZeroVector;
+		FVector3f Extent = FVector3f::OneVector;
+		// Set up when the graph is compiled, sampling it is thread safe as noted above FastNoiseLite::GetNoise
+		mutable FastNoiseLite Noise;
+	};
+
+	struct FRegister
+	{
+		// Column registers hold the whole XY plane of the chunk, the others one row
+		bool bColumn = false;
+		int32 Slot = 0;
+	};
+
+	struct FMaterialRule
+	{
+		int32 Register = INDEX_NONE;
+		float Min = 0.0f;
+		float Max = 0.0f;
+		uint8 Material = 0;
+	};
+
+	// The voxel position, X and Y per column and Z per voxel
+	static constexpr int32 PositionX = 0;
+	static constexpr int32 PositionY = 1;
+	static constexpr int32 PositionZ = 2;
+
+	TArray<FInstruction> ColumnInstructions;
+	TArray<FInstruction> VoxelInstructions;
+	TArray<FRegister> Registers;
+	int32 NumColumnSlots = 0;
+	int32 NumVoxelSlots = 0;
+	int32 DensityRegister = INDEX_NONE;
+	TArray<FMaterialRule> MaterialRules;
+	uint8 DefaultMaterial = 0;
+
+	int32 AddRegister(bool bColumn);
+	static void Run(const TArray<FInstruction>& Instructions, float* const* Rows, int Count);
+public:
+	// Null if the graph reads a node that doesn't exist or comes after the one reading it, the reason is logged
+	static TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe> Compile(const UVoxelGeneratorGraph& Graph, int32 Seed);
+	void Generate(FVector Origin, int Size, FVoxelBuffer& Data) const;
+};
+
+// Describes the terrain of a world as nodes that each compute one value per voxel from the nodes before them. The
+// density is the distance to the surface like the built in generator's, negative inside the ground.
+UCLASS(BlueprintType)
+class VOXEL_API UVoxelGeneratorGraph : public UDataAsset
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	TArray<FVoxelGraphNode> Nodes;
+
+	// Node the densities come from, the last one when INDEX_NONE
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	int32 DensityNode = INDEX_NONE;
+
+	// The first rule a voxel passes picks its material, DefaultMaterial if it passes none
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	TArray<FVoxelMaterialRule> MaterialRules;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	uint8 DefaultMaterial = 0;
+
+	// Compiled for each seed on first use and kept until the graph is edited, null while the graph is invalid. Game
+	// thread only, the program itself can be shared with any thread.
+	TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe> GetProgram(int32 Seed);
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	TMap<int32, TSharedPtr<const FVoxelGraphProgram, ESPMode::ThreadSafe>> Programs;
+};
@@ -0,0 +1,49 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "DynamicMesh/DynamicMesh3.h"
+#include "DynamicMesh/DynamicMeshAttributeSet.h"
+#include "MarchingCubes/MeshData.h"
+
+// Receives the finished mesh of a mesher, part by part
+class VOXEL_API FVoxelMeshOutput
+{
+public:
+	virtual ~FVoxelMeshOutput() = default;
+	// Starts over with an empty mesh, incremental builds keep what the previous build left instead
+	virtual void Reset() = 0;
+	virtual void Reserve(int32 VertexCount, int32 IndexCount) = 0;
+	virtual void AppendVertices(const FMCMesh& Part, TArray<int32>& OutIds) = 0;
+	// Indices refer to ids handed out by AppendVertices, the triangle ids are kept to remove the part again
+	virtual void AppendTriangles(const TArray<int>& Indices, TArray<int32>& OutIds) = 0;
+	virtual bool SupportsRemoval() const = 0;
+	// Removes triangles of an earlier build, the vertices no other triangle uses go with them unless they are kept for reuse
+	virtual void RemoveTriangles(const TArray<int32>& Ids, bool bKeepVertices) = 0;
+};
+
+class VOXEL_API FMCMeshOutput : public FVoxelMeshOutput
+{
+	FMCMesh& Mesh;
+public:
+	explicit FMCMeshOutput(FMCMesh& InMesh);
+	virtual void Reset() override;
+	virtual void Reserve(int32 VertexCount, int32 IndexCount) override;
+	virtual void AppendVertices(const FMCMesh& Part, TArray<int32>& OutIds) override;
+	virtual void AppendTriangles(const TArray<int>& Indices, TArray<int32>& OutIds) override;
+	virtual bool SupportsRemoval() const override;
+	virtual void RemoveTriangles(const TArray<int32>& Ids, bool bKeepVertices) override;
+};
+
+// Writes straight into the mesh a chunk renders. Every vertex has a color overlay element with the same id.
+class VOXEL_API FDynamicMeshOutput : public FVoxelMeshOutput
+{
+	UE::Geometry::FDynamicMesh3& Mesh;
+	UE::Geometry::FDynamicMeshColorOverlay* ColorOverlay = nullptr;
+public:
+	explicit FDynamicMeshOutput(UE::Geometry::FDynamicMesh3& InMesh);
+	virtual void Reset() override;
+	virtual void Reserve(int32 VertexCount, int32 IndexCount) override;
+	virtual void AppendVertices(const FMCMesh& Part, TArray<int32>& OutIds) override;
+	virtual void AppendTriangles(const TArray<int>& Indices, TArray<int32>& OutIds) override;
+	virtual bool SupportsRemoval() const override;
+	virtual void RemoveTriangles(const TArray<int32>& Ids, bool bKeepVertices) override;
+};
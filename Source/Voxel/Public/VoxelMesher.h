@@ -0,0 +1,108 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "MarchingCubes/CompressedVoxelBuffer.h"
+#include "MarchingCubes/MeshData.h"
+#include "MarchingCubes/VoxelData.h"
+#include "MarchingCubes/VoxelSummary.h"
+#include "VoxelMeshOutput.h"
+
+#include "VoxelMesher.generated.h"
+
+UENUM(BlueprintType)
+enum class EVoxelMesherType : uint8
+{
+	MarchingCubes,
+	// One vertex per cell at the average of its edge crossings
+	SurfaceNets,
+	// One vertex per cell fitted to the planes of its edge crossings, keeps sharp features
+	DualContouring
+};
+
+// Chunk faces that border a neighbour meshed at a finer level of detail, these are closed with transition cells
+enum class ETransitionFace : uint8
+{
+	None = 0,
+	XNeg = 1 << 0,
+	XPos = 1 << 1,
+	YNeg = 1 << 2,
+	YPos = 1 << 3,
+	ZNeg = 1 << 4,
+	ZPos = 1 << 5
+};
+ENUM_CLASS_FLAGS(ETransitionFace)
+
+// A chunk next to the one being meshed, read across the face they share. Every read stays on the plane through it
+// across that face, so a packed chunk only unpacks those planes and stays packed. Both are null for a missing chunk.
+struct FVoxelNeighbour
+{
+	const FVoxelBuffer* Voxels = nullptr;
+	const FCompressedVoxelBuffer* Packed = nullptr;
+
+	explicit operator bool() const { return Voxels || Packed; }
+	// Axis is the one the read crossed the face along
+	FVoxel GetVoxel(const int X, const int Y, const int Z, const int Axis) const
+	{
+		return Voxels ? Voxels->GetVoxel(Voxels->GetIndex(X, Y, Z)) : Packed->GetVoxel(X, Y, Z, Axis);
+	}
+};
+
+struct FVoxelMeshInput
+{
+	const FVoxelBuffer* Voxels = nullptr;
+	int Size = 0;
+	const FVoxelSummary* Summary = nullptr;
+	int Lod = 0;
+	ETransitionFace TransitionFaces = ETransitionFace::None;
+	// Voxels of the chunks past the high faces, indexed by the axes they are offset along (1 = X, 2 = Y, 4 = Z).
+	// Dual meshers need them to close the seams they own, missing chunks are null.
+	FVoxelNeighbour Neighbours[8];
+	// Chunks past the low faces, by axis. Marching cubes reads a step into them and into the high face neighbours so
+	// the normals along the faces match on both sides, missing chunks are null.
+	FVoxelNeighbour LowNeighbours[3];
+	// Set when only the voxels in [DirtyMin, DirtyMax] changed since the last build of the same mesher into the same
+	// output, meshers that keep their parts around only rebuild what those voxels touch
+	bool bIncremental = false;
+	FIntVector DirtyMin = FIntVector::ZeroValue;
+	FIntVector DirtyMax = FIntVector::ZeroValue;
+};
+
+// Borrows the scratch buffers of a build from a pool kept per thread, so they keep their capacity from one chunk to
+// the next. A build that starts on a thread while another one waits there gets a workspace of its own.
+template <typename WorkspaceType>
+class TVoxelMesherWorkspace
+{
+	WorkspaceType* Workspace;
+
+	static TArray<TUniquePtr<WorkspaceType>>& GetPool()
+	{
+		thread_local TArray<TUniquePtr<WorkspaceType>> Pool;
+		return Pool;
+	}
+public:
+	TVoxelMesherWorkspace()
+	{
+		TArray<TUniquePtr<WorkspaceType>>& Pool = GetPool();
+		Workspace = Pool.Num() > 0 ? Pool.Pop(EAllowShrinking::No).Release() : new WorkspaceType();
+	}
+	~TVoxelMesherWorkspace()
+	{
+		GetPool().Emplace(Workspace);
+	}
+	UE_NONCOPYABLE(TVoxelMesherWorkspace);
+
+	WorkspaceType& operator*() const { return *Workspace; }
+};
+
+class VOXEL_API FVoxelMesher
+{
+public:
+	// Mesh units per voxel, voxel 0 of a chunk sits at the origin of its mesh
+	static constexpr float VoxelSize = 100.0f;
+
+	virtual ~FVoxelMesher() = default;
+	virtual void Build(const FVoxelMeshInput& Input, FVoxelMeshOutput& Output) = 0;
+	FMCMesh Build(const FVoxelMeshInput& Input);
+
+	static TUniquePtr<FVoxelMesher> Create(EVoxelMesherType Type);
+};
@@ -17,4 +17,7 @@ public:
 	double GenerateTime = -1.0;
 	UPROPERTY(BlueprintReadOnly)
 	double UpdateTime = -1.0;
+	// Memory held by the voxels, compressed or not
+	UPROPERTY(BlueprintReadOnly)
+	int VoxelBytes = -1;
 };
\ No newline at end of file
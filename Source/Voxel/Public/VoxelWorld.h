@@ -1,7 +1,13 @@
 ﻿#pragma once
 #include "VoxelChunk.h"
+#include "VoxelEditJournal.h"
+#include "VoxelGenerator.h"
 #include "VoxelWorld.generated.h"
 
+class UVoxelGeneratorGraph;
+
+DECLARE_DYNAMIC_DELEGATE_OneParam(FOnVoxelChunksGenerated, const TArray<UVoxelChunk*>&, Chunks);
+
 UCLASS()
 class AVoxelWorld : public AActor
 {
@@ -18,19 +24,92 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
 	float VoxelWorldSize = 100.0f;
 
+	// Chunks per ring around the viewer before dropping to the next level of detail
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	int LodChunkRadius = 2;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	int MaxLod = 3;
+
+	// Chunks at this level of detail and beyond are decimated on a worker thread after meshing, 0 turns it off
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	int DecimationLod = 0;
+
+	// Share of its triangles a decimated chunk keeps
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel", meta = (ClampMin = "0.01", ClampMax = "1"))
+	float DecimationRatio = 0.25f;
+
+	// Chunks whose voxels nobody read or changed for this many seconds are compressed until they are needed again,
+	// 0 turns it off
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel", meta = (ClampMin = "0"))
+	float CompressIdleSeconds = 0.0f;
+
+	// Dual meshers have no transition cells and keep every chunk at full detail
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	EVoxelMesherType MesherType = EVoxelMesherType::MarchingCubes;
+
+	// Bricks keep the neighbourhood of a voxel close together for brushes and gradients, linear rows scan fastest
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	EVoxelLayout VoxelLayout = EVoxelLayout::Linear;
+
+	// Memory the undo history may take, the oldest edits are dropped past it. 0 turns undo off.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel", meta = (ClampMin = "0"))
+	float UndoMemoryMB = 64.0f;
+
+	// Terrain the chunks are generated from, the built in heightfield when empty
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	UVoxelGeneratorGraph* GeneratorGraph = nullptr;
+
+	// Worlds with the same seed and graph generate the same terrain
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Voxel")
+	int32 Seed = FVoxelGenerator::DefaultSeed;
+
 	UFUNCTION(BlueprintCallable, Category = "Voxel")
 	UVoxelChunk* GetOrCreateChunkByID(const FIntVector& ChunkID);
 
+	UFUNCTION(BlueprintPure, Category = "Voxel")
+	UVoxelChunk* FindChunk(const FIntVector& ChunkID) const;
+
+	// Creates the chunks that don't exist yet and generates all of them on worker threads. Each chunk takes its voxels
+	// on the game thread as soon as they are done, OnGenerated gets the chunks once the last one is in. A chunk that is
+	// edited or generated again before its voxels arrive keeps what it has.
+	UFUNCTION(BlueprintCallable, Category = "Voxel")
+	void GenerateChunksAsync(const TArray<FIntVector>& ChunkIDs, FOnVoxelChunksGenerated OnGenerated);
+
 	UFUNCTION(BlueprintPure, Category = "Voxel")
 	FIntVector WorldLocationToChunkID(FVector WorldLocation) const;
 
 	UFUNCTION(BlueprintCallable, Category = "Voxel", meta = (DisplayName = "Sculpt In World (Symmetrical)"))
 	void SculptInWorld_Symmetrical(UVoxelChunk* TargetChunk, UVoxelBrush* WorldSpaceBrush);
+
+	// Steps back or forward one sculpt or paint, every chunk it touched at once. Returns false if there was none.
+	UFUNCTION(BlueprintCallable, Category = "Voxel")
+	bool Undo();
+	UFUNCTION(BlueprintCallable, Category = "Voxel")
+	bool Redo();
+	UFUNCTION(BlueprintCallable, Category = "Voxel")
+	void ClearUndoHistory();
+	// Null while undo is off
+	FVoxelEditJournal* GetJournal();
+	// Made from the seed and the graph, and made again once either changes. Falls back to the built in heightfield
+	// while the graph does not compile.
+	TSharedRef<const FVoxelGenerator, ESPMode::ThreadSafe> GetGenerator();
+
+	// Picks a level of detail for every chunk from its distance to the view and remeshes the chunks that changed
+	UFUNCTION(BlueprintCallable, Category = "Voxel")
+	void UpdateLods(FVector ViewLocation);
 	
 protected:
 	UPROPERTY()
 	TMap<FIntVector, UVoxelChunk*> Chunks;
 
 private:
+	FVoxelEditJournal Journal;
+	TSharedPtr<const FVoxelGenerator, ESPMode::ThreadSafe> GeneratorInstance;
+
 	float GetBrushRadius(UVoxelBrush* Brush) const;
+	// Adds the chunk and the neighbours whose meshes read the voxels it just changed
+	void AddChunksToUpdate(UVoxelChunk* Chunk, TSet<UVoxelChunk*>& ChunksToUpdate);
+	// Takes its own copy, a chunk regenerating while they apply drops its deltas from the journal they came from
+	void ApplyDeltas(TArray<FVoxelChunkDelta> Deltas);
 };